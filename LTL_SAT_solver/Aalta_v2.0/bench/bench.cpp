@@ -0,0 +1,293 @@
+/*
+ * Microbenchmarks of the formula and SAT layers
+ *
+ * File:   bench.cpp
+ *
+ *   aalta_bench [-r reps] [-b bench,...] name=file ...
+ * times every benchmark on every input set: the nonblank lines of file,
+ * each one an aalta --batch input (LTL, DAG or exists*forall* HyperLTL).
+ * Every repetition starts from an empty formula store, so the cached
+ * results of simplify (), flatted () and to_set () are computed again;
+ * only the operation itself is timed. Reported per input formula are
+ * the time, the allocations (operator new) and the unique formulas
+ * created.
+ *   aalta_bench --sat file
+ *   aalta_bench --impl file1 file2
+ * print the aalta inputs of eahyper's satisfiability and implication
+ * checks (see eahyper_input.h); bench/run.sh uses them to build the
+ * input sets from benchmarks/.
+ */
+
+#include "formula/aalta_formula.h"
+#include "formula/dag_formula.h"
+#include "formula/dnf_formula.h"
+#include "formula/hyper_formula.h"
+#include "formula/olg_formula.h"
+#include "checking/nondeter_checker.h"
+#include "checking/solver_session.h"
+#include "util/utility.h"
+#include "eahyper_input.h"
+
+#include <atomic>
+#include <fstream>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+using namespace std;
+
+static atomic<long> allocations (0);
+
+void *
+operator new (size_t size)
+{
+  allocations ++;
+  void *p = malloc (size == 0 ? 1 : size);
+  if (p == NULL)
+    throw bad_alloc ();
+  return p;
+}
+
+void
+operator delete (void *p) noexcept
+{
+  free (p);
+}
+
+void
+operator delete (void *p, size_t) noexcept
+{
+  free (p);
+}
+
+static double
+now_ns ()
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static vector<string>
+read_lines (const char *path)
+{
+  ifstream in (path);
+  if (!in.is_open ())
+    {
+      print_error ((string ("cannot open ") + path).c_str ());
+      exit (1);
+    }
+  vector<string> res;
+  string line;
+  while (getline (in, line))
+    if (line.find_first_not_of (" \t\r") != string::npos)
+      res.push_back (line);
+  return res;
+}
+
+// 与aalta --batch相同的输入
+static aalta_formula *
+parse (const string& input)
+{
+  if (hyper_formula::is_hyper (input.c_str ()))
+    return hyper_formula (input.c_str ()).expand ();
+  if (dag_formula::is_dag (input.c_str ()))
+    return dag_formula::parse (input.c_str ());
+  return aalta_formula (input.c_str ()).unique ();
+}
+
+/*
+ * The state a benchmark starts from: the formulas of the input set,
+ * prepared up to the given stage outside the timing.
+ */
+enum stage { RAW, PARSED, SIMPLIFIED, FLATTED };
+
+struct input_set
+{
+  string name;
+  vector<string> lines;
+  vector<aalta_formula *> afs;
+};
+
+static solver_session *session;
+
+static void
+reset ()
+{
+  dnf_formula::destroy ();   // includes aalta_formula::destroy ()
+  session->reset ();
+}
+
+static void
+prepare (input_set& in, stage st)
+{
+  reset ();
+  in.afs.clear ();
+  if (st == RAW)
+    return;
+  for (int i = 0; i < in.lines.size (); i++)
+    {
+      aalta_formula *af = parse (in.lines[i]);
+      if (st >= SIMPLIFIED)
+        af = af->simplify ();
+      if (st >= FLATTED)
+        af = af->flatted ();
+      in.afs.push_back (af);
+    }
+}
+
+// 自底向上重建af的每个节点: unique ()在唯一表中命中
+static aalta_formula *
+rebuild (aalta_formula *af, hash_map<aalta_formula *, aalta_formula *, aalta_formula::af_prt_hash>& done)
+{
+  if (af == NULL)
+    return NULL;
+  hash_map<aalta_formula *, aalta_formula *, aalta_formula::af_prt_hash>::iterator it = done.find (af);
+  if (it != done.end ())
+    return it->second;
+  aalta_formula *l = rebuild (af->l_af (), done);
+  aalta_formula *r = rebuild (af->r_af (), done);
+  aalta_formula *res = aalta_formula (af->oper (), l, r).unique ();
+  done[af] = res;
+  return res;
+}
+
+static volatile long sink;
+
+static void
+run (input_set& in, int i, const char *bench)
+{
+  aalta_formula *af = i < in.afs.size () ? in.afs[i] : NULL;
+  if (strcmp (bench, "parse") == 0)
+    in.afs.push_back (parse (in.lines[i]));
+  else if (strcmp (bench, "unique") == 0)
+    {
+      hash_map<aalta_formula *, aalta_formula *, aalta_formula::af_prt_hash> done;
+      sink += rebuild (af, done)->id ();
+    }
+  else if (strcmp (bench, "simplify") == 0)
+    sink += af->simplify ()->id ();
+  else if (strcmp (bench, "flatted") == 0)
+    sink += af->flatted ()->id ();
+  else if (strcmp (bench, "to_set") == 0)
+    sink += af->to_set ().size ();
+  else if (strcmp (bench, "SAT_core") == 0)
+    sink += af->SAT ().size ();
+  else if (strcmp (bench, "dnf") == 0)
+    sink += dnf_formula (af).unique ()->get_next ()->size ();
+  else if (strcmp (bench, "olg") == 0)
+    {
+      olg_formula olg (af);
+      sink += olg.sat () + 2 * olg.unsat ();
+    }
+  else if (strcmp (bench, "check") == 0)
+    {
+      nondeter_checker ch (af);
+      sink += ch.check ();
+      session->reset ();
+    }
+}
+
+struct bench_t
+{
+  const char *name;
+  stage from;
+};
+
+static const bench_t benches[] = {
+  {"parse", RAW}, {"unique", PARSED}, {"simplify", PARSED},
+  {"flatted", SIMPLIFIED}, {"to_set", SIMPLIFIED}, {"SAT_core", FLATTED},
+  {"dnf", SIMPLIFIED}, {"olg", SIMPLIFIED}, {"check", SIMPLIFIED}
+};
+
+static void
+measure (input_set& in, const bench_t& b, int reps)
+{
+  double ns = 0;
+  long allocs = 0, nodes = 0;
+  for (int r = 0; r < reps; r++)
+    {
+      prepare (in, b.from);
+      int before = aalta_formula::unique_count ();
+      long a = allocations;
+      double start = now_ns ();
+      for (int i = 0; i < in.lines.size (); i++)
+        run (in, i, b.name);
+      ns += now_ns () - start;
+      allocs += allocations - a;
+      nodes += aalta_formula::unique_count () - before;
+    }
+  double ops = (double) reps * in.lines.size ();
+  printf ("%-12s %-10s %8.0f %14.1f %12.1f %10.1f\n", in.name.c_str (), b.name,
+          ops, ns / ops, allocs / ops, nodes / ops);
+  fflush (stdout);
+}
+
+static void
+usage ()
+{
+  printf ("usage: aalta_bench [-r reps] [-b bench,...] name=file ...\n");
+  printf ("       aalta_bench --sat file\n");
+  printf ("       aalta_bench --impl file1 file2\n");
+  printf ("benchmarks:");
+  for (int i = 0; i < sizeof (benches) / sizeof (benches[0]); i++)
+    printf (" %s", benches[i].name);
+  printf ("\n");
+  exit (1);
+}
+
+int
+main (int argc, char **argv)
+{
+  if (argc == 3 && strcmp (argv[1], "--sat") == 0)
+    {
+      vector<string> lines = read_lines (argv[2]);
+      for (int i = 0; i < lines.size (); i++)
+        printf ("%s\n", eahyper_input (lines[i].c_str ()).sat ().c_str ());
+      return 0;
+    }
+  if (argc == 4 && strcmp (argv[1], "--impl") == 0)
+    {
+      vector<string> f = read_lines (argv[2]), g = read_lines (argv[3]);
+      if (f.size () != 1 || g.size () != 1)
+        usage ();
+      printf ("%s\n", eahyper_input::impl (eahyper_input (f[0].c_str ()), eahyper_input (g[0].c_str ())).c_str ());
+      return 0;
+    }
+
+  int reps = 3;
+  string only;
+  vector<input_set> inputs;
+  for (int i = 1; i < argc; i++)
+    {
+      if (strcmp (argv[i], "-r") == 0 && i + 1 < argc)
+        reps = atoi (argv[++i]);
+      else if (strcmp (argv[i], "-b") == 0 && i + 1 < argc)
+        only = string (",") + argv[++i] + ",";
+      else if (strchr (argv[i], '=') != NULL)
+        {
+          input_set in;
+          const char *eq = strchr (argv[i], '=');
+          in.name = string ((const char *) argv[i], eq);
+          in.lines = read_lines (eq + 1);
+          if (!in.lines.empty ())
+            inputs.push_back (in);
+        }
+      else
+        usage ();
+    }
+  if (inputs.empty () || reps < 1)
+    usage ();
+
+  session = new solver_session;
+  session->activate ();
+  printf ("%-12s %-10s %8s %14s %12s %10s\n", "input", "bench", "ops", "ns/op", "allocs/op", "nodes/op");
+  for (int i = 0; i < inputs.size (); i++)
+    for (int j = 0; j < sizeof (benches) / sizeof (benches[0]); j++)
+      if (only.empty () || only.find (string (",") + benches[j].name + ",") != string::npos)
+        measure (inputs[i], benches[j], reps);
+  reset ();
+  return 0;
+}
@@ -0,0 +1,258 @@
+/*
+ * File:   eahyper_input.cpp
+ */
+
+#include "eahyper_input.h"
+#include "util/utility.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace std;
+
+static const char *op_names[] = {
+  "t", "f", "a", "!", "X", "F", "G", "&", "|", "->", "<->", "U", "R", "W"
+};
+
+eahyper_input::eahyper_input (const char *input)
+{
+  _input = _pos = input;
+  next_token ();
+  while (_token == "forall" || _token == "exists")
+    {
+      bool forall = _token == "forall";
+      next_token ();
+      if (_token.empty () || !isalnum (_token[0]))
+        error ("trace variable expected");
+      (forall ? _forall : _exists).push_back (_token);
+      next_token ();
+      expect (".");
+    }
+  _root = parse_temporal ();
+  if (!_token.empty ())
+    error ("unexpected input");
+}
+
+void
+eahyper_input::error (const char *msg)
+{
+  print_error ((string ("eahyper input at '") + string (_pos).substr (0, 20) + "': " + msg).c_str ());
+  exit (1);
+}
+
+/**
+ * 读下一个词; 输入结束时_token为空
+ * Keywords are the maximal runs of letters and digits that equal them,
+ * as in eahyper's lexer.
+ */
+void
+eahyper_input::next_token ()
+{
+  while (isspace (*_pos)) _pos++;
+  const char *begin = _pos;
+  if (*_pos == '\0')
+    ;
+  else if (isalnum (*_pos))
+    while (isalnum (*_pos)) _pos++;
+  else if (strncmp (_pos, "<->", 3) == 0 || strncmp (_pos, "<=>", 3) == 0)
+    _pos += 3;
+  else if (strncmp (_pos, "->", 2) == 0 || strncmp (_pos, "=>", 2) == 0)
+    _pos += 2;
+  else
+    _pos++;
+  _token = string (begin, _pos);
+  if (_token == "<=>")
+    _token = "<->";
+  else if (_token == "=>")
+    _token = "->";
+  else if (_token == "~")
+    _token = "!";
+}
+
+void
+eahyper_input::expect (const char *token)
+{
+  if (_token != token)
+    error ((string ("'") + token + "' expected").c_str ());
+  next_token ();
+}
+
+int
+eahyper_input::add (int op, int left, int right)
+{
+  node n;
+  n.op = op;
+  n.left = left;
+  n.right = right;
+  _nodes.push_back (n);
+  return _nodes.size () - 1;
+}
+
+// U, W, R: 右结合, 优先级最低
+int
+eahyper_input::parse_temporal ()
+{
+  int left = parse_implies ();
+  int op = _token == "U" ? Until : (_token == "R" ? Release : (_token == "W" ? WeakUntil : -1));
+  if (op < 0)
+    return left;
+  next_token ();
+  return add (op, left, parse_temporal ());
+}
+
+// ->, <->: 左结合
+int
+eahyper_input::parse_implies ()
+{
+  int res = parse_and_or ();
+  while (_token == "->" || _token == "<->")
+    {
+      int op = _token == "->" ? Implies : Equiv;
+      next_token ();
+      res = add (op, res, parse_and_or ());
+    }
+  return res;
+}
+
+// &, |: 左结合, 优先级相同
+int
+eahyper_input::parse_and_or ()
+{
+  int res = parse_unary ();
+  while (_token == "&" || _token == "|")
+    {
+      int op = _token == "&" ? And : Or;
+      next_token ();
+      res = add (op, res, parse_unary ());
+    }
+  return res;
+}
+
+int
+eahyper_input::parse_unary ()
+{
+  if (_token == "!" || _token == "X" || _token == "F" || _token == "G")
+    {
+      int op = _token == "!" ? Not : (_token == "X" ? Next : (_token == "F" ? Future : Globally));
+      next_token ();
+      return add (op, -1, parse_unary ());
+    }
+  if (_token == "(")
+    {
+      next_token ();
+      int res = parse_temporal ();
+      expect (")");
+      return res;
+    }
+  if (_token == "True" || _token == "False")
+    {
+      int op = _token == "True" ? True : False;
+      next_token ();
+      return add (op, -1, -1);
+    }
+  // prop_trace, prop和trace都可以含有'_', trace是能匹配的最长的量词变量
+  if (_token.empty () || !isalnum (_token[0]))
+    error ("formula expected");
+  string name = _token;
+  next_token ();
+  while (_token == "_")
+    {
+      next_token ();
+      if (_token.empty () || !isalnum (_token[0]))
+        error ("atom expected");
+      name += "_" + _token;
+      next_token ();
+    }
+  vector<string> quantified = _forall;
+  quantified.insert (quantified.end (), _exists.begin (), _exists.end ());
+  int i = trace_of (name, quantified);
+  if (i < 0)
+    error ("atom without quantified trace variable");
+  int res = add (Atom, -1, -1);
+  _nodes[res].prop = name.substr (0, name.size () - quantified[i].size () - 1);
+  _nodes[res].trace = quantified[i];
+  return res;
+}
+
+int
+eahyper_input::dag_writer::define (const string& def)
+{
+  map<string, int>::iterator it = numbers.find (def);
+  if (it != numbers.end ())
+    return it->second;
+  int res = numbers.size ();
+  numbers[def] = res;
+  defs += (res == 0 ? " " : "; ") + def;
+  return res;
+}
+
+/**
+ * 输出第index个节点及其子公式的定义, 返回其编号
+ * An atom gets the name prop_trace with the trace renamed by traces,
+ * or just prop if it is renamed to "".
+ */
+int
+eahyper_input::emit (int index, const trace_map& traces, dag_writer& w) const
+{
+  const node& n = _nodes[index];
+  string def = op_names[n.op];
+  if (n.op == Atom)
+    {
+      trace_map::const_iterator it = traces.find (n.trace);
+      if (it == traces.end ())
+        {
+          print_error (("eahyper input: trace variable " + n.trace + " is not quantified").c_str ());
+          exit (1);
+        }
+      def += " " + n.prop + (it->second.empty () ? "" : "_" + it->second);
+    }
+  if (n.left >= 0)
+    def += " " + convert_to_string (emit (n.left, traces, w));
+  if (n.right >= 0)
+    def += " " + convert_to_string (emit (n.right, traces, w));
+  return w.define (def);
+}
+
+// 全称trace变量依次改名为prefix0, prefix1, ...
+eahyper_input::trace_map
+eahyper_input::rename (const char *prefix) const
+{
+  if (!_exists.empty ())
+    {
+      print_error ("eahyper input: only forall* formulas are supported");
+      exit (1);
+    }
+  trace_map res;
+  for (int i = 0; i < _forall.size (); i++)
+    res[_forall[i]] = prefix + convert_to_string (i);
+  return res;
+}
+
+string
+eahyper_input::sat () const
+{
+  trace_map traces = rename ("");
+  for (trace_map::iterator it = traces.begin (); it != traces.end (); it++)
+    it->second = "";
+  dag_writer w;
+  emit (_root, traces, w);
+  return "dag" + w.defs;
+}
+
+string
+eahyper_input::impl (const eahyper_input& f, const eahyper_input& g)
+{
+  trace_map ftraces = f.rename ("f"), gtraces = g.rename ("g");
+  dag_writer w;
+  int l = f.emit (f._root, ftraces, w);
+  int r = g.emit (g._root, gtraces, w);
+  r = w.define ("! " + convert_to_string (r));
+  w.define ("& " + convert_to_string (l) + " " + convert_to_string (r));
+  string prefix;
+  for (int i = 0; i < g._forall.size (); i++)
+    prefix += "exists g" + convert_to_string (i) + ". ";
+  for (int i = 0; i < f._forall.size (); i++)
+    prefix += "forall f" + convert_to_string (i) + ". ";
+  return prefix + "dag" + w.defs;
+}
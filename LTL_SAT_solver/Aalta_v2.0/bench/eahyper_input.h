@@ -0,0 +1,76 @@
+/*
+ * File:   eahyper_input.h
+ *
+ * Turns the HyperLTL benchmarks of eahyper (benchmarks/ of this
+ * repository) into aalta inputs the way eahyper does:
+ *   sat:  a forall* formula is equisatisfiable to its body on one
+ *         trace, which is printed as a DAG (formula/dag_formula.h);
+ *   impl: f implies g for forall* f and g iff
+ *         exists g's traces. forall f's traces. f & !g
+ *         is unsatisfiable, which is printed as exists*forall*
+ *         HyperLTL (formula/hyper_formula.h) with a DAG body.
+ * The syntax is eahyper's: ~ or !, &, |, -> or =>, <-> or <=>, X, F,
+ * G, U, W (weak until), R, True, False and atoms prop_trace; & and |
+ * bind equally strong, as do -> and <->, and U, W, R bind weakest.
+ */
+
+#ifndef EAHYPER_INPUT_H
+#define	EAHYPER_INPUT_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+class eahyper_input
+{
+private:
+  enum opkind
+  {
+    True, False, Atom, Not, Next, Future, Globally,
+    And, Or, Implies, Equiv, Until, Release, WeakUntil
+  };
+  struct node
+  {
+    int op;
+    int left, right;
+    std::string prop, trace; // 原子 prop_trace
+  };
+  std::vector<node> _nodes;
+  std::vector<std::string> _exists, _forall; // 量词前缀
+  int _root;
+
+  // 词法分析
+  const char *_input, *_pos;
+  std::string _token;
+  void next_token ();
+  void expect (const char *token);
+  void error (const char *msg);
+
+  // 语法分析, 按优先级由低到高
+  int parse_temporal ();
+  int parse_implies ();
+  int parse_and_or ();
+  int parse_unary ();
+  int add (int op, int left, int right);
+
+  // 输出: DAG定义, 相同的定义只输出一次
+  struct dag_writer
+  {
+    std::string defs;
+    std::map<std::string, int> numbers;
+    int define (const std::string& def);
+  };
+  typedef std::map<std::string, std::string> trace_map; // trace变量的改名
+  int emit (int index, const trace_map& traces, dag_writer& w) const;
+  trace_map rename (const char *prefix) const;
+
+public:
+  eahyper_input (const char *input);
+
+  /* forall*公式的可满足性 */
+  std::string sat () const;
+  /* forall*公式f蕴含g, 当且仅当结果不可满足 */
+  static std::string impl (const eahyper_input& f, const eahyper_input& g);
+};
+
+#endif	/* EAHYPER_INPUT_H */
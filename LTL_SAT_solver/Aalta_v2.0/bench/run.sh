@@ -0,0 +1,74 @@
+#!/bin/bash
+
+# Builds the input sets of aalta_bench from benchmarks/ and runs it on
+# them; the arguments (e.g. -r 5 -b simplify,check) are passed on.
+#   random_40, random_60  satisfiability of the first formula file
+#   symm                  implications between the symmetry formulas
+#   hd, od, qn            implications between small generated instances
+# The hd, od and qn generators are built with go; without go these sets
+# are skipped. dnf_formula expands the whole formula, which blows up on
+# all but random_40, so unless -b is given the dnf benchmark only runs
+# there.
+
+cd "$(dirname "$0")/.." || exit 1
+BENCH=./aalta_bench
+ROOT=../../benchmarks
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+[ -x "$BENCH" ] || make bench || exit 1
+
+sets=()
+
+for n in 40 60
+do
+    first=$(ls "$ROOT/random/random_$n" | head -n 1)
+    "$BENCH" --sat "$ROOT/random/random_$n/$first" > "$WORK/random_$n"
+    sets+=("random_$n=$WORK/random_$n")
+done
+
+for (( i=1; i <= 4; i++ ))
+do
+    for (( j=1; j <= 4; j++ ))
+    do
+        "$BENCH" --impl "$ROOT/symm/symmetry_formulas/symm$i" "$ROOT/symm/symmetry_formulas/symm$j" >> "$WORK/symm"
+    done
+done
+sets+=("symm=$WORK/symm")
+
+# family, generator option, first and last size
+generated ()
+{
+    go build -o "$WORK/$1_gen" "$ROOT/$1/$1_gen.go" || return
+    for (( i=$3; i <= $4; i++ ))
+    do
+        "$WORK/$1_gen" "$2" "$i" > "$WORK/$1_$i"
+    done
+    for (( i=$3; i <= $4; i++ ))
+    do
+        for (( j=$3; j <= $4; j++ ))
+        do
+            "$BENCH" --impl "$WORK/$1_$i" "$WORK/$1_$j" >> "$WORK/$1"
+        done
+    done
+    sets+=("$1=$WORK/$1")
+}
+
+if which go > /dev/null 2>&1
+then
+    generated hd -d 0 3
+    generated od -t 1 3
+    generated qn -c 1 3
+else
+    echo "go not found, skipping hd, od and qn" >&2
+fi
+
+case " $* " in
+    *" -b "*)
+        "$BENCH" "$@" "${sets[@]}"
+        ;;
+    *)
+        "$BENCH" -b parse,unique,simplify,flatted,to_set,SAT_core,olg,check "$@" "${sets[@]}"
+        "$BENCH" -b dnf "$@" "${sets[0]}" | tail -n +2
+        ;;
+esac
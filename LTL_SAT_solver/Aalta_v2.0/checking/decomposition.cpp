@@ -0,0 +1,194 @@
+/*
+ * Checking a conjunction by its atom-disjoint parts
+ *
+ * File:   decomposition.cpp
+ */
+
+ #include "decomposition.h"
+ #include "nondeter_checker.h"
+ #include <stdio.h>
+ #include <signal.h>
+ #include <poll.h>
+ #include <unistd.h>
+ #include <sys/wait.h>
+
+ bool decomposition::_enabled = true;
+
+ void
+ decomposition::enable (bool enabled)
+ {
+   _enabled = enabled;
+ }
+
+ //union-find over the conjuncts
+ static int
+ find (std::vector<int>& parent, int i)
+ {
+   while (parent[i] != i)
+   {
+     parent[i] = parent[parent[i]];
+     i = parent[i];
+   }
+   return i;
+ }
+
+ decomposition::decomposition (aalta_formula *f)
+ {
+   _input = f;
+   if (!_enabled || f->oper () != aalta_formula::And)
+   {
+     _parts.push_back (f);
+     return;
+   }
+   const aalta_formula::af_prt_set& conjuncts = f->to_set ();
+   std::vector<aalta_formula *> cs (conjuncts.begin (), conjuncts.end ());
+   std::vector<int> parent (cs.size ());
+   hash_map<aalta_formula *, int, aalta_formula::af_prt_hash> owner;   //a conjunct of every atom
+   for (int i = 0; i < cs.size (); i ++)
+   {
+     parent[i] = i;
+     const aalta_formula::af_prt_set& atoms = cs[i]->get_alphabet ();
+     for (aalta_formula::af_prt_set::const_iterator it = atoms.begin (); it != atoms.end (); it ++)
+     {
+       hash_map<aalta_formula *, int, aalta_formula::af_prt_hash>::iterator oit = owner.find (*it);
+       if (oit == owner.end ())
+         owner[*it] = i;
+       else
+         parent[find (parent, i)] = find (parent, oit->second);
+     }
+   }
+   std::vector<aalta_formula::af_prt_set> groups;
+   hash_map<int, int> group_of;   //root conjunct -> position in groups
+   for (int i = 0; i < cs.size (); i ++)
+   {
+     int root = find (parent, i);
+     hash_map<int, int>::iterator git = group_of.find (root);
+     if (git == group_of.end ())
+     {
+       git = group_of.insert (std::make_pair (root, (int) groups.size ())).first;
+       groups.push_back (aalta_formula::af_prt_set ());
+     }
+     groups[git->second].insert (cs[i]);
+   }
+   if (groups.size () == 1)
+   {
+     _parts.push_back (f);
+     return;
+   }
+   for (int i = 0; i < groups.size (); i ++)
+     _parts.push_back (aalta_formula::merge (aalta_formula::And, groups[i])->simplify ());
+ }
+
+ char
+ decomposition::check_part (aalta_formula *f)
+ {
+   nondeter_checker ch (f);
+   bool sat = ch.check ();
+   if (ch.unknown ())
+     return '?';
+   return sat ? 's' : 'u';
+ }
+
+ const char*
+ decomposition::check ()
+ {
+   if (_parts.size () == 1)
+   {
+     char c = check_part (_input);
+     return c == 's' ? "sat" : (c == 'u' ? "unsat" : "unknown");
+   }
+
+   long cpus = sysconf (_SC_NPROCESSORS_ONLN);
+   int jobs = cpus < 1 ? 1 : (int) cpus;
+   std::vector<pid_t> pids;
+   std::vector<struct pollfd> fds;
+   int next = 0, running = 0;
+   bool unknown = false, unsat = false;
+   fflush (stdout);
+   while (!unsat && (next < _parts.size () || running > 0))
+   {
+     //start parts while there are free processors
+     while (next < _parts.size () && running < jobs)
+     {
+       int p[2];
+       if (pipe (p) != 0)
+       {
+         unknown = true;
+         next ++;
+         continue;
+       }
+       pid_t pid = fork ();
+       if (pid == 0)
+       {
+         close (p[0]);
+         char c;
+         try
+         {
+           c = check_part (_parts[next]);
+         }
+         catch (...)   //e.g. bad_alloc
+         {
+           c = '?';
+         }
+         if (write (p[1], &c, 1) != 1)
+           _exit (1);
+         _exit (0);
+       }
+       close (p[1]);
+       next ++;
+       if (pid < 0)
+       {
+         close (p[0]);
+         unknown = true;
+         continue;
+       }
+       struct pollfd pfd;
+       pfd.fd = p[0];
+       pfd.events = POLLIN;
+       pids.push_back (pid);
+       fds.push_back (pfd);
+       running ++;
+     }
+     if (running == 0)
+       break;
+
+     //a part that crashes only closes its pipe
+     if (poll (&fds[0], fds.size (), -1) < 0)
+     {
+       unknown = true;
+       break;
+     }
+     for (int i = 0; i < fds.size (); i ++)
+     {
+       if (fds[i].fd < 0 || fds[i].revents == 0)
+         continue;
+       char c = '?';
+       if (read (fds[i].fd, &c, 1) != 1)
+         c = '?';
+       close (fds[i].fd);
+       fds[i].fd = -1;
+       waitpid (pids[i], NULL, 0);
+       pids[i] = -1;
+       running --;
+       if (c == 'u')
+       {
+         unsat = true;
+         break;
+       }
+       if (c != 's')
+         unknown = true;
+     }
+   }
+
+   for (int i = 0; i < pids.size (); i ++)
+   {
+     if (pids[i] < 0)
+       continue;
+     close (fds[i].fd);
+     kill (pids[i], SIGKILL);
+     waitpid (pids[i], NULL, 0);
+   }
+   if (unsat)
+     return "unsat";
+   return unknown ? "unknown" : "sat";
+ }
@@ -0,0 +1,39 @@
+/*
+ * Checking a conjunction by its atom-disjoint parts
+ *
+ * File:   decomposition.h
+ *
+ * Conjuncts of the input that share no atoms constrain different parts
+ * of a model, so the input is satisfiable iff each group of connected
+ * conjuncts is. The groups are checked by nondeter_checker in forked
+ * processes, at most one per processor at a time, and the input is
+ * unsat as soon as one group is. An input that does not split is
+ * checked in this process as before.
+ */
+
+#ifndef DECOMPOSITION_H
+#define DECOMPOSITION_H
+
+#include "formula/aalta_formula.h"
+#include <vector>
+
+class decomposition
+{
+  public:
+    decomposition (aalta_formula*);
+    //"sat", "unsat", or "unknown" if a part gave up
+    const char* check ();
+    const std::vector<aalta_formula*>& parts () const {return _parts;}
+
+    static void enable (bool);
+
+  private:
+    aalta_formula *_input;
+    std::vector<aalta_formula*> _parts;
+
+    static bool _enabled;
+
+    static char check_part (aalta_formula*);
+};
+
+#endif
@@ -10,6 +10,10 @@
  
  #include "nondeter_checker.h"
  #include "formula/olg_formula.h"
+ #include "formula/sat_context.h"
+ #include "solver_session.h"
+ #include "util/utility.h"
+ #include "util/statistics.h"
  #include <stdio.h>
  #include <iostream>
  #include <stdlib.h>
@@ -17,20 +21,55 @@
  
  using namespace std;
  
- std::vector<aalta_formula::af_prt_set> nondeter_checker::_visited_edges;
- std::vector<aalta_formula*> nondeter_checker::_visited;
- aalta_formula::af_prt_set nondeter_checker::_explored;
- nondeter_checker::formula_int_map nondeter_checker::_formula_ints;
- int nondeter_checker::_satisfied_pos = 0;
- int nondeter_checker::_next_satisfied_pos = 0;
+ nondeter_checker::session_data::session_data ()
+ {
+   count = 0;
+   _satisfied_pos = 0;
+   _next_satisfied_pos = 0;
+   _start = true;
+   compute_next_wanted_count_ = 0;
+ }
  
- bool nondeter_checker::_start = true;
+ //the until marks of _edge_untils and _until_positions are in _visited_edges
+ void 
+ nondeter_checker::session_data::mark () const
+ {
+   for (int i = 0; i < _visited_edges.size (); i ++)
+     aalta_formula::mark (_visited_edges[i]);
+   for (int i = 0; i < _visited.size (); i ++)
+     aalta_formula::mark (_visited[i]);
+   aalta_formula::mark (_explored);
+   for (formula_int_map::const_iterator it = _formula_ints.begin (); it != _formula_ints.end (); it ++)
+     aalta_formula::mark (it->first);
+ }
  
+ nondeter_checker::session_data& 
+ nondeter_checker::session ()
+ {
+   return *solver_session::current ()._checker;
+ }
  
- nondeter_checker::nondeter_checker (aalta_formula *f) : checker (f)
+ size_t nondeter_checker::_memory_limit = 0;
+ size_t nondeter_checker::_gc_threshold = 0;
+ bool nondeter_checker::_use_symmetry = true;
+ std::vector<std::string> nondeter_checker::_symmetric_traces;
+ std::vector<std::string> nondeter_checker::_trace_names;
+ 
+ nondeter_checker::nondeter_checker (aalta_formula *f, bool pursue_sat) : checker (f)
  {
    _unsat_pos = -1;
+   _unknown = false;
+   _pursue_sat = pursue_sat;
+   sat_context::reset ();
    _input = seperate_next (_input);
+   if (_use_symmetry)
+   {
+     _symmetry.set_traces (_trace_names);
+     if (_symmetric_traces.empty ())
+       _symmetry.discover (_input);
+     else
+       _symmetry.add_class (_input, _symmetric_traces);
+   }
  }
  
  aalta_formula* 
@@ -85,14 +124,8 @@
  {
    for (int i = 0; i < _sccs.size (); i ++)
      _sccs[i]->destroy ();
-   scc_transition::destroy ();
-   _visited.clear ();
-   _visited_edges.clear ();
-   _explored.clear ();
  }
  
- int nondeter_checker::count = 0;
- 
  bool 
  nondeter_checker::check ()
  {
@@ -111,125 +144,242 @@
          return false;
      }
      
-     _visited.push_back (_input);
-     _formula_ints.insert (pair<aalta_formula*, int> (_input, 0));
+     session ()._visited.push_back (_input);
+     session ()._formula_ints.insert (pair<aalta_formula*, int> (_symmetry.canonical (_input), 0));
      //printf ("%s\n\n", _input->to_string().c_str ());
      return dfs ();
    }
  }
  
+ //the search used to recurse once per state, so deep instances ran out of
+ //C stack. It is now a loop over an explicit stack of dfs_frame, one frame
+ //per state on _visited that is being expanded; the bookkeeping on
+ //_visited, _visited_edges and _formula_ints is the same as before.
  bool 
  nondeter_checker::dfs ()
  {
-   aalta_formula *f, *pf, *cf, *nx, *neg;
-   aalta_formula::af_prt_set P;
-   //printf ("count = %d, begin dfs\n", count++);
+   enum { EXPAND, NEXT_EDGE, BACKTRACK } step = EXPAND;
+   std::vector<dfs_frame> stack;
+   std::pair<aalta_formula::af_prt_set, aalta_formula*> pa;
+   aalta_formula *f, *nx;
+   int expanded = 0;
+   _pinned = aalta_formula::unique_count ();
+   _collected_live = aalta_formula::live_count ();
    
+   while (true)
    {
-     f = _visited.back ();
-     if (f == aalta_formula::TRUE ())
-       return true;
-     if (f == aalta_formula::FALSE ())
+     switch (step)
      {
-       _visited.pop_back ();
-       return false;
-     }
-     
-     nondeter_prog_state *pgst = new nondeter_prog_state (f);
-       
-     set_next_wanted (f);
-     
-     
-     std::pair<aalta_formula::af_prt_set, aalta_formula*> pa = pgst->get_next_pair (_visited.size ());
-
-     while ((!pa.first.empty ()) || (pa.second != aalta_formula::FALSE ()))
-     {  
-       //printf ("pa.first is:\n");
-       //print (pa.first);
-       
-       aalta_formula *temp = nondeter_prog_state::erase_global (pa.second);
-       /*
-       if (temp != NULL)
-         printf ("pa.second is:\n%s\n", temp->to_string ().c_str ());
-       else
-         printf ("pa.second is:\n%s\n", (pa.second)->to_string ().c_str ());
-       */
+       case EXPAND:  //the state on top of _visited was just reached
+       {
+         f = session ()._visited.back ();
+         if (f == aalta_formula::TRUE ())
+         {
+           release_frames (stack);
+           return true;
+         }
+         if (f == aalta_formula::FALSE ())
+         {
+           session ()._visited.pop_back ();
+           if (stack.empty ())
+             return false;
+           step = BACKTRACK;
+           break;
+         }
+         if (collection_due ())
+           collect (stack, pa);
+         if (++ expanded % MEMORY_CHECK_INTERVAL == 0 && out_of_memory ())
+         {
+           release_frames (stack);
+           _unknown = true;
+           return false;
+         }
+         statistics::states ++;
+         dfs_frame fr;
+         fr.f = f;
+         fr.pgst = new nondeter_prog_state (f);
+         fr.nx = NULL;
+         stack.push_back (fr);
+         set_next_wanted (f);
+         pa = fr.pgst->get_next_pair (session ()._visited.size ());
+         step = NEXT_EDGE;
+         break;
+       }
        
-       _visited_edges.push_back (pa.first);
-       nx = pa.second;
-       if (_explored.find (nx) == _explored.end ())
+       case NEXT_EDGE:  //follow the edge pa of the top frame
        {
-         int pos = visited (nx);
-         if (pos >= 0)
+         dfs_frame& fr = stack.back ();
+         if (pa.first.empty () && pa.second == aalta_formula::FALSE ())
          {
-           if (model (pos))
-           {
-             delete pgst;
-             return true;
-           } 
+           delete fr.pgst;
+           stack.pop_back ();
+           if (stack.empty ())
+             return false;
+           step = BACKTRACK;
+           break;
          }
-         //else
+         
+         //unused, but it creates formulas and the search depends on their ids
+         nondeter_prog_state::erase_global (pa.second);
+         push_edge (pa.first);
+         nx = pa.second;
+         fr.nx = nx;
+         step = BACKTRACK;
+         if (session ()._explored.find (nx) == session ()._explored.end ())
          {
-           _visited.push_back (nx);
-           if (dfs ())
+           int pos = visited (nx);
+           if (pos >= 0 && model (pos))
            {
-             delete pgst;
+             release_frames (stack);
              return true;
-           }      
-               
+           }
+           session ()._visited.push_back (nx);
+           step = EXPAND;
          }
+         break;
        }
        
-       _visited.pop_back ();
-       if (_visited.size ()-1 < _next_satisfied_pos)
-         _next_satisfied_pos --;
-       _visited_edges.pop_back ();
-       formula_int_map::iterator it = _formula_ints.find (nx);
-       if (it != _formula_ints.end ())
-         _formula_ints.erase (it);
-       
-       if (_explored.find (f) != _explored.end ())
+       case BACKTRACK:  //the edge to fr.nx failed, undo it
        {
-         delete pgst;
-         //printf ("count = %d, false, return back\n", count --);
-         return false;
+         dfs_frame& fr = stack.back ();
+         statistics::backtracks ++;
+         session ()._visited.pop_back ();
+         if (session ()._visited.size ()-1 < session ()._next_satisfied_pos)
+           session ()._next_satisfied_pos --;
+         pop_edge ();
+         formula_int_map::iterator it = session ()._formula_ints.find (_symmetry.canonical (fr.nx));
+         if (it != session ()._formula_ints.end ())
+           session ()._formula_ints.erase (it);
+         
+         if (session ()._explored.find (fr.f) != session ()._explored.end ())
+         {
+           delete fr.pgst;
+           stack.pop_back ();
+           if (stack.empty ())
+             return false;
+           break;
+         }
+         
+         pa = fr.pgst->get_next_pair (session ()._visited.size ());
+         step = NEXT_EDGE;
+         break;
        }
-       
-       
-       pa = pgst->get_next_pair (_visited.size ());
-       //printf ("_visisted size: %d\n", _visited.size ());
-       //printf ("_visited_edges size: %d\n", _visited_edges.size ());
      }
-
-     delete pgst;
-     
    }
-   //printf ("count = %d, false, return back\n\n\n", -- count);
-   return false;
  }
  
- int nondeter_checker::compute_next_wanted_count_ = 0;
+ void 
+ nondeter_checker::use_symmetry (bool use)
+ {
+   _use_symmetry = use;
+ }
+ 
+ void 
+ nondeter_checker::set_symmetric_traces (const std::vector<std::string>& traces)
+ {
+   _symmetric_traces = traces;
+ }
+ 
+ void 
+ nondeter_checker::set_trace_names (const std::vector<std::string>& traces)
+ {
+   _trace_names = traces;
+ }
+ 
+ void 
+ nondeter_checker::release_frames (std::vector<dfs_frame>& stack)
+ {
+   for (int i = 0; i < stack.size (); i ++)
+     delete stack[i].pgst;
+   stack.clear ();
+ }
+ 
+ //the memory ceiling is compared with the resident size of the whole process
+ bool 
+ nondeter_checker::out_of_memory ()
+ {
+   if (_memory_limit == 0)
+     return false;
+   return resident_memory () > _memory_limit;
+ }
+ 
+ void 
+ nondeter_checker::set_memory_limit (size_t megabytes)
+ {
+   _memory_limit = megabytes * 1024 * 1024;
+ }
+ 
+ void 
+ nondeter_checker::set_gc_threshold (size_t formulas)
+ {
+   _gc_threshold = formulas;
+ }
+ 
+ bool 
+ nondeter_checker::collection_due ()
+ {
+   if (_gc_threshold == 0)
+     return false;
+   size_t created = aalta_formula::live_count () - _collected_live;
+   return created >= _gc_threshold && created >= _collected_live;
+ }
+ 
+ //the formulas the search still uses are those of the dfs frames, of the
+ //last edge, of the session and of the symmetry caches; the formulas the
+ //search created and none of them uses are released. The store is shared,
+ //so nothing is collected while another session is alive, and no session
+ //is created until the collection is done
+ void 
+ nondeter_checker::collect (const std::vector<dfs_frame>& stack, const std::pair<aalta_formula::af_prt_set, aalta_formula*>& pa)
+ {
+   std::lock_guard<std::mutex> guard (solver_session::_alive_lock);
+   if (solver_session::_alive > 1)
+   {
+     _collected_live = aalta_formula::live_count ();   //try again after as many new ones
+     return;
+   }
+   aalta_formula::begin_collection (_pinned);
+   aalta_formula::mark (_input);
+   for (int i = 0; i < stack.size (); i ++)
+   {
+     aalta_formula::mark (stack[i].f);
+     aalta_formula::mark (stack[i].nx);
+     stack[i].pgst->mark ();
+   }
+   aalta_formula::mark (pa.first);
+   aalta_formula::mark (pa.second);
+   solver_session::current ().mark ();
+   _symmetry.forget_unmarked ();
+   statistics::formulas_reclaimed += aalta_formula::end_collection ();
+   statistics::collections ++;
+   _collected_live = aalta_formula::live_count ();
+   if (_collected_live > statistics::formulas_live)
+     statistics::formulas_live = _collected_live;
+ }
+ 
  void 
  nondeter_checker::set_next_wanted (aalta_formula *f)
  {
-   if (_start)
+   if (session ()._start)
    {
      nondeter_prog_state::initial_unsatisfied (_input);
-     _start = false;
+     session ()._start = false;
    }
+   if (!_pursue_sat)
+     return;
    if (nondeter_prog_state::unsatisfied ().empty () && !nondeter_prog_state::no_until_fulfilled ())
    {
-     compute_next_wanted_count_ ++;
+     session ().compute_next_wanted_count_ ++;
      
      //if set_next_wanted has been computed for 10 times but still not get the satisfying model,  
      //then decline this heuristics.
-     if (compute_next_wanted_count_ <= 10)
+     if (session ().compute_next_wanted_count_ <= 10)
      {
        //if (_satisfied_pos != _next_satisfied_pos)
        //printf ("_satisfied_pos is %d\n_next_satisfied_pos is %d\n", _satisfied_pos, _next_satisfied_pos);
        aalta_formula *flat = f->flatted ();
-       _satisfied_pos = _next_satisfied_pos;
-       _next_satisfied_pos = _visited.size () - 1;
+       session ()._satisfied_pos = session ()._next_satisfied_pos;
+       session ()._next_satisfied_pos = session ()._visited.size () - 1;
        aalta_formula *f = get_next_wanted (flat);
        //assert (f == NULL)
        //f = nondeter_prog_state::convert_to_formula (nondeter_prog_state::global ());
@@ -245,9 +395,9 @@
    aalta_formula *res = NULL;
    aalta_formula *nx;
    //printf ("_satisfied_pos is %d\n", _satisfied_pos);
-   for (int i = _satisfied_pos; i >= 0; i--)
+   for (int i = session ()._satisfied_pos; i >= 0; i--)
    {
-     nx = get_next_formula (_visited[i], P);
+     nx = get_next_formula (session ()._visited[i], P);
      if (nx != NULL)
      {
        if (res == NULL)
@@ -412,14 +562,18 @@
    news.clear ();
  }
  
+ //the position of f on _visited, or of a state that is f up to exchanging
+ //traces: the path from that state to f repeated with the traces
+ //exchanged returns to it, so the loop check there is still sound
  int 
  nondeter_checker::visited (aalta_formula *f)
  {
-   formula_int_map::iterator it = _formula_ints.find (f);
-   if (it != _formula_ints.end ())
+   f = _symmetry.canonical (f);
+   formula_int_map::iterator it = session ()._formula_ints.find (f);
+   if (it != session ()._formula_ints.end ())
      return it->second;
    else
-     _formula_ints.insert (pair<aalta_formula*, int> (f, _visited.size ()));
+     session ()._formula_ints.insert (pair<aalta_formula*, int> (f, session ()._visited.size ()));
    /*
    for (int i = _visited.size ()-1; i >= 0; i --)
    {
@@ -433,38 +587,76 @@
    return -1;
  }
  
+ //a back edge to _visited[pos] closes a loop over the edges pos ... top of
+ //_visited_edges. A mark occurs on one of them iff its last position is at
+ //least pos, so the check only looks at the untils of _visited[pos] and
+ //not at the edges of the loop.
  bool 
  nondeter_checker::model (int pos)
  {
-   aalta_formula::af_prt_set P, P2;
-   for (int i = pos; i < _visited_edges.size (); i ++)
+   return fulfilled (session ()._visited[pos], pos);
+ }
+ 
+ //whether the loop from pos fulfils the untils of f
+ bool 
+ nondeter_checker::fulfilled (aalta_formula *f, int pos)
+ {
+   hash_map<aalta_formula*, std::vector<int>, aalta_formula::af_prt_hash>::iterator it;
+   switch (f->oper ())
    {
-     P2 = collect_until (_visited_edges[i]);
-     P.insert (P2.begin (), P2.end ());
+     case aalta_formula::Until:
+       it = session ()._until_positions.find (f->find_var ());
+       return it != session ()._until_positions.end () && it->second.back () >= pos;
+     case aalta_formula::Release:
+       return true;
+     case aalta_formula::And:
+       return fulfilled (f->l_af (), pos) && fulfilled (f->r_af (), pos);
+     case aalta_formula::Or:
+       return fulfilled (f->l_af (), pos) || fulfilled (f->r_af (), pos);
+     case aalta_formula::Undefined:
+       return false;
+     default:
+       return true;
    }
-   //printf ("nondeter_checker::model: satisfied are:\n");
-   //checker::print (P);
-   if (_visited[pos]->model_until (P))
-     return true;
-   return false;
  }
  
- aalta_formula::af_prt_set 
- nondeter_checker::collect_until (aalta_formula::af_prt_set P)
+ void 
+ nondeter_checker::push_edge (const aalta_formula::af_prt_set& P)
  {
-   aalta_formula::af_prt_set res;
-   for (aalta_formula::af_prt_set::iterator it = P.begin (); it != P.end (); it ++)
+   int pos = session ()._visited_edges.size ();
+   session ()._visited_edges.push_back (P);
+   session ()._edge_untils.push_back (std::vector<aalta_formula*> ());
+   std::vector<aalta_formula*>& marks = session ()._edge_untils.back ();
+   for (aalta_formula::af_prt_set::const_iterator it = P.begin (); it != P.end (); it ++)
    {
      if ((*it)->is_until_marked ())
-       res.insert (*it);
+     {
+       marks.push_back (*it);
+       session ()._until_positions[*it].push_back (pos);
+     }
    }
-   return res;
+ }
+ 
+ void 
+ nondeter_checker::pop_edge ()
+ {
+   std::vector<aalta_formula*>& marks = session ()._edge_untils.back ();
+   for (int i = 0; i < marks.size (); i ++)
+   {
+     hash_map<aalta_formula*, std::vector<int>, aalta_formula::af_prt_hash>::iterator it;
+     it = session ()._until_positions.find (marks[i]);
+     it->second.pop_back ();
+     if (it->second.empty ())
+       session ()._until_positions.erase (it);
+   }
+   session ()._edge_untils.pop_back ();
+   session ()._visited_edges.pop_back ();
  }
  
  bool 
- nondeter_checker::unsat_of_core (aalta_formula* f, aalta_formula::af_prt_set P)
+ nondeter_checker::unsat_of_core (aalta_formula* f, const aalta_formula::af_prt_set& P)
  {
-   aalta_formula::af_prt_set::iterator it;
+   aalta_formula::af_prt_set::const_iterator it;
    aalta_formula::af_prt_set P2;
    aalta_formula *pf;
    for (it = P.begin (); it != P.end (); it ++)
@@ -15,29 +15,96 @@
 #include "progression/progression.h"
 #include "formula/aalta_formula.h"
 #include "scc.h"
+#include "symmetry.h"
 #include <vector>
 
 class nondeter_checker :public checker 
 {
   public:
-    nondeter_checker (aalta_formula*);
+    //pursue_sat enables the heuristic that steers the search back to
+    //the visited states once all untils are fulfilled
+    nondeter_checker (aalta_formula*, bool pursue_sat = true);
     ~nondeter_checker ();
     bool check ();
     void show_evidence ();
+    //true if the last check () gave up because of the memory limit; 
+    //check () returns false in that case
+    bool unknown () const { return _unknown; }
+    static void set_memory_limit (size_t);  //in MB, 0 for no limit
+    //the search releases the formulas it no longer uses once it has
+    //created this many new ones since the last collection, or as many as
+    //the last collection kept if that is more; 0 (the default) for no
+    //collection. Nothing is collected while another session is alive
+    static void set_gc_threshold (size_t);
+    //states equal up to exchanging traces count as the same state in the
+    //loop check; the interchangeable traces are discovered from the atom
+    //names unless they are given
+    static void use_symmetry (bool);
+    static void set_symmetric_traces (const std::vector<std::string>&);
+    //the trace variables of the input, which the atom names end in; see
+    //symmetry::set_traces
+    static void set_trace_names (const std::vector<std::string>&);
     
-    bool unsat_of_core (aalta_formula*, aalta_formula::af_prt_set);
+    bool unsat_of_core (aalta_formula*, const aalta_formula::af_prt_set&);
     //static void destroy ();
     typedef hash_map<aalta_formula*, int, aalta_formula::af_prt_hash, aalta_formula::af_prt_eq> formula_int_map;
+    
+    //the search state of one checking run, owned by a solver_session
+    struct session_data
+    {
+      session_data ();
+      std::vector<aalta_formula::af_prt_set> _visited_edges;
+      //the until marks on each edge of _visited_edges, and for each mark
+      //the positions in _visited_edges where it occurs, in increasing
+      //order; both follow the pushes and pops of _visited_edges
+      std::vector<std::vector<aalta_formula*> > _edge_untils;
+      hash_map<aalta_formula*, std::vector<int>, aalta_formula::af_prt_hash> _until_positions;
+      std::vector<aalta_formula*> _visited;  
+      aalta_formula::af_prt_set _explored;
+      formula_int_map _formula_ints;
+      int count;
+      int _satisfied_pos;
+      int _next_satisfied_pos;
+      bool _start;
+      int compute_next_wanted_count_;
+      void mark () const;   //for a collection, see collect ()
+    };
   private:
+    static session_data& session ();
     int _unsat_pos;
+    bool _unknown;
+    bool _pursue_sat;
+    static size_t _memory_limit;  //in bytes
+    static size_t _gc_threshold;
+    int _pinned;                  //the formulas with smaller ids are older than the search
+    int _collected_live;          //the live formulas after the last collection
+    static bool _use_symmetry;
+    static std::vector<std::string> _symmetric_traces;
+    static std::vector<std::string> _trace_names;
+    symmetry _symmetry;
+    
+    //one state of the dfs that is being expanded
+    struct dfs_frame
+    {
+      aalta_formula *f;
+      nondeter_prog_state *pgst;
+      aalta_formula *nx;  //target of the edge taken last
+    };
+    enum { MEMORY_CHECK_INTERVAL = 256 };
     bool dfs ();
+    void release_frames (std::vector<dfs_frame>&);
+    bool out_of_memory ();
+    bool collection_due ();
+    void collect (const std::vector<dfs_frame>&, const std::pair<aalta_formula::af_prt_set, aalta_formula*>&);
     bool model (int);
     int visited (aalta_formula*);
     void update_scc (scc*);
     void update_explored (aalta_formula*);
     aalta_formula* seperate_next (aalta_formula*);
     void confirm_explored ();
-    aalta_formula::af_prt_set collect_until (aalta_formula::af_prt_set);
+    void push_edge (const aalta_formula::af_prt_set&);
+    void pop_edge ();
+    bool fulfilled (aalta_formula*, int);
     
     
     
@@ -50,15 +117,6 @@ class nondeter_checker :public checker
     
     
     std::vector<scc*> _sccs;
-    static std::vector<aalta_formula::af_prt_set> _visited_edges;
-    static std::vector<aalta_formula*> _visited;  
-    static aalta_formula::af_prt_set _explored;
-    static formula_int_map _formula_ints;
-    static int count;
-    static int _satisfied_pos;
-    static int _next_satisfied_pos;
-    static bool _start;
-    static int compute_next_wanted_count_;
 };
 
 
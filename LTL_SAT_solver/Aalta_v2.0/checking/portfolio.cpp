@@ -0,0 +1,123 @@
+/* 
+ * Portfolio satisfiability checking
+ * 
+ * File:   portfolio.cpp
+ */
+ 
+ #include "portfolio.h"
+ #include "nondeter_checker.h"
+ #include "sat_solver.h"
+ #include <stdio.h>
+ #include <signal.h>
+ #include <poll.h>
+ #include <unistd.h>
+ #include <sys/wait.h>
+ #include <vector>
+ 
+ //the engines, every one writes 's', 'u' or '?' to its pipe
+ enum { NONDETER, NONDETER_PLAIN, OBLIGATION, ENGINES };
+ 
+ portfolio::portfolio (aalta_formula *f)
+ {
+   _input = f;
+ }
+ 
+ char 
+ portfolio::run_engine (int engine, aalta_formula *f)
+ {
+   switch (engine)
+   {
+     case NONDETER:         //the default checker
+     case NONDETER_PLAIN:   //the same without the heuristic pursuing sat
+     {
+       nondeter_checker ch (f, engine == NONDETER);
+       bool sat = ch.check ();
+       if (ch.unknown ())
+         return '?';
+       return sat ? 's' : 'u';
+     }
+     case OBLIGATION:       //tarjan search with obligation acceleration
+     {
+       sat_solver solver;
+       return solver.sat (f->classify ()) ? 's' : 'u';
+     }
+   }
+   return '?';
+ }
+ 
+ const char* 
+ portfolio::check ()
+ {
+   std::vector<pid_t> pids;
+   std::vector<struct pollfd> fds;
+   fflush (stdout);
+   for (int i = 0; i < ENGINES; i ++)
+   {
+     int p[2];
+     if (pipe (p) != 0)
+       continue;
+     pid_t pid = fork ();
+     if (pid == 0)
+     {
+       close (p[0]);
+       char c;
+       try
+       {
+         c = run_engine (i, _input);
+       }
+       catch (...)   //e.g. bad_alloc of an engine that blew up
+       {
+         c = '?';
+       }
+       if (write (p[1], &c, 1) != 1)
+         _exit (1);
+       _exit (0);
+     }
+     close (p[1]);
+     if (pid < 0)
+     {
+       close (p[0]);
+       continue;
+     }
+     struct pollfd pfd;
+     pfd.fd = p[0];
+     pfd.events = POLLIN;
+     pids.push_back (pid);
+     fds.push_back (pfd);
+   }
+   
+   //an engine that crashes or gives up only closes its pipe
+   const char *res = "unknown";
+   int open = fds.size ();
+   while (open > 0)
+   {
+     if (poll (&fds[0], fds.size (), -1) < 0)
+       break;
+     for (int i = 0; i < fds.size (); i ++)
+     {
+       if (fds[i].fd < 0 || fds[i].revents == 0)
+         continue;
+       char c = '?';
+       if (read (fds[i].fd, &c, 1) != 1)
+         c = '?';
+       close (fds[i].fd);
+       fds[i].fd = -1;
+       open --;
+       if (c == 's' || c == 'u')
+       {
+         res = (c == 's') ? "sat" : "unsat";
+         open = 0;
+         break;
+       }
+     }
+   }
+   
+   for (int i = 0; i < pids.size (); i ++)
+   {
+     if (fds[i].fd >= 0)
+       close (fds[i].fd);
+     kill (pids[i], SIGKILL);
+     waitpid (pids[i], NULL, 0);
+   }
+   return res;
+ }
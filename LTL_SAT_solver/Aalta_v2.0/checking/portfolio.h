@@ -0,0 +1,30 @@
+/* 
+ * Portfolio satisfiability checking
+ * 
+ * File:   portfolio.h
+ * 
+ * Runs the satisfiability engines of aalta on the same formula in
+ * forked processes and takes the first definitive answer; the other
+ * processes are killed. The engines keep static state (sat_solver, the
+ * olg and dnf stores), so they do not share one address space.
+ */
+
+#ifndef PORTFOLIO_H
+#define PORTFOLIO_H
+
+#include "formula/aalta_formula.h"
+
+class portfolio 
+{
+  public:
+    portfolio (aalta_formula*);
+    //"sat", "unsat", or "unknown" if no engine answered
+    const char* check ();
+    
+  private:
+    aalta_formula *_input;
+    
+    static char run_engine (int, aalta_formula*);
+};
+
+#endif
@@ -0,0 +1,240 @@
+/*
+ * Persistent satisfiability results
+ *
+ * File:   result_cache.cpp
+ */
+
+ #include "result_cache.h"
+ #include "util/utility.h"
+ #include <stdlib.h>
+ #include <string.h>
+ #include <fcntl.h>
+ #include <unistd.h>
+ #include <sys/file.h>
+ #include <sys/mman.h>
+ #include <sys/stat.h>
+ #include <algorithm>
+
+ using namespace std;
+
+ static const char MAGIC[8] = {'A', 'A', 'L', 'T', 'A', 'R', 'C', '1'};
+
+ result_cache::result_cache (const char *path)
+ {
+   _size = sizeof (header) + SLOTS * sizeof (slot);
+   _fd = open (path, O_RDWR | O_CREAT, 0666);
+   if (_fd < 0)
+   {
+     print_error (("cannot open the result cache " + string (path)).c_str ());
+     exit (1);
+   }
+   //the first process creates the table, the others wait for it
+   flock (_fd, LOCK_EX);
+   struct stat st;
+   if (fstat (_fd, &st) != 0 || (st.st_size == 0 && ftruncate (_fd, _size) != 0))
+   {
+     print_error (("cannot create the result cache " + string (path)).c_str ());
+     exit (1);
+   }
+   if (st.st_size != 0 && st.st_size != (off_t) _size)
+   {
+     print_error ((string (path) + " is not a result cache of this aalta").c_str ());
+     exit (1);
+   }
+   void *mem = mmap (NULL, _size, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+   if (mem == MAP_FAILED)
+   {
+     print_error (("cannot map the result cache " + string (path)).c_str ());
+     exit (1);
+   }
+   _header = (header *) mem;
+   _slots = (slot *) (_header + 1);
+   if (st.st_size == 0)
+   {
+     memcpy (_header->magic, MAGIC, sizeof (MAGIC));
+     _header->slots = SLOTS;
+   }
+   else if (memcmp (_header->magic, MAGIC, sizeof (MAGIC)) != 0 || _header->slots != SLOTS)
+   {
+     print_error ((string (path) + " is not a result cache of this aalta").c_str ());
+     exit (1);
+   }
+   flock (_fd, LOCK_UN);
+ }
+
+ result_cache::~result_cache ()
+ {
+   munmap (_header, _size);
+   close (_fd);
+ }
+
+ //two independent 64 bit hashes (FNV-1a and a multiplicative one)
+ void
+ result_cache::hash (const string& s, uint64_t& h1, uint64_t& h2)
+ {
+   h1 = 14695981039346656037ULL;
+   h2 = s.size ();
+   for (size_t i = 0; i < s.size (); i ++)
+   {
+     h1 = (h1 ^ (unsigned char) s[i]) * 1099511628211ULL;
+     h2 = (h2 + (unsigned char) s[i]) * 0x9E3779B97F4A7C15ULL;
+     h2 ^= h2 >> 29;
+   }
+   if (h1 == 0 && h2 == 0)   //reserved for free slots
+     h2 = 1;
+ }
+
+ const char*
+ result_cache::lookup (const string& key, double *time)
+ {
+   uint64_t h1, h2;
+   hash (key, h1, h2);
+   const char *res = NULL;
+   flock (_fd, LOCK_SH);
+   for (int i = 0; i < PROBES; i ++)
+   {
+     slot& sl = _slots[(h1 + i) % SLOTS];
+     if (sl.key1 == 0 && sl.key2 == 0)
+       break;
+     if (sl.key1 == h1 && sl.key2 == h2)
+     {
+       res = sl.result == 's' ? "sat" : "unsat";
+       if (time != NULL)
+         *time = sl.time;
+       break;
+     }
+   }
+   flock (_fd, LOCK_UN);
+   return res;
+ }
+
+ void
+ result_cache::store (const string& key, const char *result, double time)
+ {
+   uint64_t h1, h2;
+   hash (key, h1, h2);
+   flock (_fd, LOCK_EX);
+   slot *target = &_slots[h1 % SLOTS];
+   for (int i = 0; i < PROBES; i ++)
+   {
+     slot& sl = _slots[(h1 + i) % SLOTS];
+     if ((sl.key1 == 0 && sl.key2 == 0) || (sl.key1 == h1 && sl.key2 == h2))
+     {
+       target = &sl;
+       break;
+     }
+   }
+   target->key1 = h1;
+   target->key2 = h2;
+   target->time = time;
+   target->result = strcmp (result, "sat") == 0 ? 's' : 'u';
+   flock (_fd, LOCK_UN);
+ }
+
+ //the operands of nested op (& or |) formulas
+ void
+ result_cache::operands (int op, aalta_formula *f, vector<aalta_formula*>& res)
+ {
+   if (f->oper () == op)
+   {
+     operands (op, f->l_af (), res);
+     operands (op, f->r_af (), res);
+   }
+   else
+     res.push_back (f);
+ }
+
+ //a hash of f that ignores the atom names and the order of the operands of & and |
+ size_t
+ result_cache::shape (aalta_formula *f, hash_map<aalta_formula*, size_t, aalta_formula::af_prt_hash>& done)
+ {
+   if (f == NULL)
+     return 0;
+   hash_map<aalta_formula*, size_t, aalta_formula::af_prt_hash>::iterator it = done.find (f);
+   if (it != done.end ())
+     return it->second;
+   size_t res;
+   int op = f->oper ();
+   if (op > aalta_formula::Undefined)
+     res = aalta_formula::Undefined + 1;
+   else if (op == aalta_formula::And || op == aalta_formula::Or)
+   {
+     vector<aalta_formula*> ops;
+     operands (op, f, ops);
+     vector<size_t> shapes;
+     for (size_t i = 0; i < ops.size (); i ++)
+       shapes.push_back (shape (ops[i], done));
+     sort (shapes.begin (), shapes.end ());
+     res = op;
+     for (size_t i = 0; i < shapes.size (); i ++)
+       res = res * 31 + shapes[i];
+   }
+   else
+     res = (op * 31 + shape (f->l_af (), done)) * 31 + shape (f->r_af (), done);
+   done[f] = res;
+   return res;
+ }
+
+ //f with the atoms numbered in the order they are reached and the operands
+ //of & and | ordered by their shape. Operands of the same shape stay in
+ //id order, so some renamed formulas get different strings; that only
+ //costs a cache miss
+ void
+ result_cache::print (aalta_formula *f, hash_map<aalta_formula*, size_t, aalta_formula::af_prt_hash>& shapes,
+                      hash_map<int, int>& atoms, string& res)
+ {
+   if (res.size () > MAX_KEY)
+     return;
+   int op = f->oper ();
+   if (op > aalta_formula::Undefined)
+   {
+     hash_map<int, int>::iterator it = atoms.find (op);
+     if (it == atoms.end ())
+       it = atoms.insert (make_pair (op, (int) atoms.size ())).first;
+     res += "#" + convert_to_string (it->second);
+   }
+   else if (op == aalta_formula::And || op == aalta_formula::Or)
+   {
+     vector<aalta_formula*> ops;
+     operands (op, f, ops);
+     vector<pair<size_t, int> > order;
+     for (size_t i = 0; i < ops.size (); i ++)
+       order.push_back (make_pair (shapes[ops[i]], (int) i));
+     sort (order.begin (), order.end ());
+     res += "(";
+     for (size_t i = 0; i < order.size (); i ++)
+     {
+       if (i > 0)
+         res += " " + aalta_formula::get_name (op) + " ";
+       print (ops[order[i].second], shapes, atoms, res);
+     }
+     res += ")";
+   }
+   else if (f->l_af () == NULL && f->r_af () == NULL)
+     res += aalta_formula::get_name (op);
+   else
+   {
+     res += "(";
+     if (f->l_af () != NULL)
+     {
+       print (f->l_af (), shapes, atoms, res);
+       res += " ";
+     }
+     res += aalta_formula::get_name (op) + " ";
+     print (f->r_af (), shapes, atoms, res);
+     res += ")";
+   }
+ }
+
+ string
+ result_cache::fingerprint (aalta_formula *f)
+ {
+   hash_map<aalta_formula*, size_t, aalta_formula::af_prt_hash> shapes;
+   hash_map<int, int> atoms;
+   shape (f, shapes);
+   string res;
+   print (f, shapes, atoms, res);
+   if (res.size () > MAX_KEY)
+     return "";
+   return res;
+ }
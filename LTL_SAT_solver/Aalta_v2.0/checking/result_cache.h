@@ -0,0 +1,67 @@
+/*
+ * Persistent satisfiability results
+ *
+ * File:   result_cache.h
+ *
+ * A table of answers in a file that is memory-mapped by every aalta
+ * process using it. The key is a fingerprint of the simplified input
+ * that does not change when the atoms are renamed or the operands of
+ * & and | are reordered, so equal questions asked by different runs are
+ * answered without a search. Lookups take a shared and stores an
+ * exclusive flock on the file, so several processes can use one cache.
+ * The table has a fixed number of slots; when the probe sequence of a
+ * key is full, its first slot is overwritten.
+ */
+
+#ifndef RESULT_CACHE_H
+#define RESULT_CACHE_H
+
+#include "formula/aalta_formula.h"
+#include <stdint.h>
+#include <string>
+
+class result_cache
+{
+  public:
+    result_cache (const char *path);
+    ~result_cache ();
+
+    //the renaming invariant form of f, the key of its answer; empty if
+    //it would be longer than MAX_KEY (f shares many subformulas)
+    static std::string fingerprint (aalta_formula*);
+
+    //"sat" or "unsat" stored for key, NULL if there is none; the time
+    //the search took is written to time if it is not NULL
+    const char* lookup (const std::string& key, double *time = NULL);
+    void store (const std::string& key, const char *result, double time);
+
+  private:
+    enum { SLOTS = 1 << 16, PROBES = 16, MAX_KEY = 1 << 20 };
+    struct slot
+    {
+      uint64_t key1, key2;  //0, 0 for a free slot
+      float time;
+      char result;          //'s' or 'u'
+    };
+    struct header
+    {
+      char magic[8];
+      uint32_t slots;
+    };
+
+    int _fd;
+    size_t _size;
+    header *_header;
+    slot *_slots;
+
+    static void hash (const std::string&, uint64_t&, uint64_t&);
+    static void print (aalta_formula*, hash_map<aalta_formula*, size_t, aalta_formula::af_prt_hash>&,
+                       hash_map<int, int>&, std::string&);
+    static size_t shape (aalta_formula*, hash_map<aalta_formula*, size_t, aalta_formula::af_prt_hash>&);
+    static void operands (int, aalta_formula*, std::vector<aalta_formula*>&);
+
+    result_cache (const result_cache&);
+    result_cache& operator = (const result_cache&);
+};
+
+#endif
@@ -11,6 +11,7 @@
  #include "scc.h"
  #include "progression/nondeter_prog_state.h"
  #include "checking/checker.h"
+ #include "solver_session.h"
  #include <iostream>
  #include <stdio.h>
  #include <stdlib.h>
@@ -22,9 +23,13 @@
  
  
  
- scc_transition::scc_tran_set scc_transition::_trans;
+ scc_transition::session_data& 
+ scc_transition::session ()
+ {
+   return *solver_session::current ()._scc_transitions;
+ }
  
- scc_transition::scc_transition (aalta_formula::af_prt_set P, scc_state* st)
+ scc_transition::scc_transition (const aalta_formula::af_prt_set& P, scc_state* st)
  {
    _edge = P;
    _dest = st->get_id ();
@@ -39,13 +44,13 @@
  scc_transition* 
  scc_transition::unique ()
  {
-   scc_tran_set::iterator it = _trans.find (this);
-   if (it != _trans.end ())
+   scc_tran_set::iterator it = session ()._trans.find (this);
+   if (it != session ()._trans.end ())
      return *it;
    else
    {
      scc_transition *t = clone ();
-     _trans.insert (t);
+     session ()._trans.insert (t);
      return t;
    }
  }
@@ -106,28 +111,47 @@
    printf ("%s -> %d\n", str.c_str (), _dest);
  }
  
- void 
- scc_transition::destroy ()
+ scc_transition::session_data::~session_data ()
  {
    scc_tran_set::iterator it;
    for (it = _trans.begin (); it != _trans.end (); it ++)
      delete *it;
  }
  
- int scc_state::_max_id = 0;
+ void 
+ scc_transition::session_data::mark () const
+ {
+   scc_tran_set::const_iterator it;
+   for (it = _trans.begin (); it != _trans.end (); it ++)
+     aalta_formula::mark ((*it)->_edge);
+ }
+ 
  //std::vector<scc_state*> scc_state::_sts;
- scc_state::formula_id_map scc_state::_formula_ids;
+ 
+ scc_state::session_data& 
+ scc_state::session ()
+ {
+   return *solver_session::current ()._scc_states;
+ }
+ 
+ void 
+ scc_state::session_data::mark () const
+ {
+   formula_id_map::const_iterator it;
+   for (it = _formula_ids.begin (); it != _formula_ids.end (); it ++)
+     aalta_formula::mark (it->first);
+ }
  
  scc_state::scc_state (aalta_formula* f)
  {
    _formula = f;
-   formula_id_map::iterator it = _formula_ids.find (f);
-   if (it != _formula_ids.end ())
+   formula_id_map::iterator it = session ()._formula_ids.find (f);
+   if (it != session ()._formula_ids.end ())
      _id = it->second;
    else 
    {
-     _id = _max_id ++;
-     _formula_ids.insert (std::pair<aalta_formula*, int> (f, _id));
+     _id = session ()._max_id ++;
+     session ()._formula_ids.insert (std::pair<aalta_formula*, int> (f, _id));
    }
    //_sts.push_back (this);
  }
@@ -135,13 +159,13 @@
  scc_state::scc_state (scc_transition::scc_tran_set trans, aalta_formula *f)
  {
    _formula = f;
-   formula_id_map::iterator it = _formula_ids.find (f);
-   if (it != _formula_ids.end ())
+   formula_id_map::iterator it = session ()._formula_ids.find (f);
+   if (it != session ()._formula_ids.end ())
      _id = it->second;
    else 
    {
-     _id = _max_id ++;
-     _formula_ids.insert (std::pair<aalta_formula*, int> (f, _id));
+     _id = session ()._max_id ++;
+     session ()._formula_ids.insert (std::pair<aalta_formula*, int> (f, _id));
    }
    _trans = trans;
  }
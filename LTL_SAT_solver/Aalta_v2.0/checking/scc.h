@@ -38,19 +38,26 @@ class scc_transition
       }
     };
   
-    scc_transition (aalta_formula::af_prt_set, scc_state*);
+    scc_transition (const aalta_formula::af_prt_set&, scc_state*);
     scc_transition (const scc_transition &);
     ~scc_transition () {}
     bool operator == (const scc_transition& )const;
     scc_transition* unique ();
     void print ();
-    static void destroy ();
     typedef hash_set<scc_transition*, scc_tran_prt_hash, scc_tran_prt_eq> scc_tran_set;
+    
+    //the unique transitions of one checking run, owned by a solver_session
+    struct session_data
+    {
+      ~session_data ();
+      scc_tran_set _trans;
+      void mark () const;   //for a collection, see nondeter_checker::collect ()
+    };
   private:
     size_t _hash;
     aalta_formula::af_prt_set _edge;
     int _dest;
-    static scc_tran_set _trans;
+    static session_data& session ();
     
     scc_transition* clone ();
     void hash ();
@@ -69,15 +76,23 @@ class scc_state
      scc_state* clone ();
      void print ();
      void destroy ();
+     typedef hash_map<aalta_formula*, int, aalta_formula::af_prt_hash, aalta_formula::af_prt_eq> formula_id_map;
+     
+     //the state ids of one checking run, owned by a solver_session
+     struct session_data
+     {
+       session_data () {_max_id = 0;}
+       int _max_id;
+       formula_id_map _formula_ids;
+       void mark () const;
+     };
    private:
      int _id;
      aalta_formula *_formula;
      scc_transition::scc_tran_set _trans;
      
      //static std::vector<scc_state*> _sts;
-     static int _max_id;
-     typedef hash_map<aalta_formula*, int, aalta_formula::af_prt_hash, aalta_formula::af_prt_eq> formula_id_map;
-     static formula_id_map _formula_ids;
+     static session_data& session ();
 };
  
  
@@ -0,0 +1,84 @@
+/* 
+ * The state of one satisfiability checking run
+ * 
+ * File:   solver_session.cpp
+ */
+ 
+ #include "solver_session.h"
+ 
+ thread_local solver_session* solver_session::_current = NULL;
+ int solver_session::_alive = 0;
+ std::mutex solver_session::_alive_lock;
+ 
+ solver_session::solver_session ()
+ {
+   std::lock_guard<std::mutex> guard (_alive_lock);
+   _alive ++;
+   create ();
+ }
+ 
+ solver_session::~solver_session ()
+ {
+   std::lock_guard<std::mutex> guard (_alive_lock);
+   _alive --;
+   release ();
+   if (_current == this)
+     _current = NULL;
+ }
+ 
+ void 
+ solver_session::activate ()
+ {
+   _current = this;
+ }
+ 
+ //the state is recreated rather than cleared, since the iteration order
+ //of the hashed containers (and hence the search) depends on the bucket count
+ void 
+ solver_session::reset ()
+ {
+   release ();
+   create ();
+ }
+ 
+ //the SAT context comes last: it only caches, and keeps what the others use
+ void 
+ solver_session::mark ()
+ {
+   _checker->mark ();
+   _prog_states->mark ();
+   _scc_transitions->mark ();
+   _scc_states->mark ();
+   _sat->forget_unmarked ();
+ }
+ 
+ solver_session& 
+ solver_session::current ()
+ {
+   if (_current == NULL)
+   {
+     static thread_local solver_session default_session;
+     _current = &default_session;
+   }
+   return *_current;
+ }
+ 
+ void 
+ solver_session::create ()
+ {
+   _checker = new nondeter_checker::session_data ();
+   _prog_states = new nondeter_prog_state::session_data ();
+   _scc_transitions = new scc_transition::session_data ();
+   _scc_states = new scc_state::session_data ();
+   _sat = new sat_context::session_data ();
+ }
+ 
+ void 
+ solver_session::release ()
+ {
+   delete _checker;
+   delete _prog_states;
+   delete _scc_transitions;
+   delete _scc_states;
+   delete _sat;
+ }
@@ -0,0 +1,62 @@
+/* 
+ * The state of one satisfiability checking run
+ * 
+ * File:   solver_session.h
+ * 
+ * A solver_session owns everything the nondeterministic checker, the
+ * progression, the scc construction and the SAT context keep between
+ * calls. Every thread works on its own current session (a default one
+ * is created on first use); several sessions can exist side by side and
+ * are switched by activate (). The hash-consed aalta_formula store is
+ * shared by all sessions, so aalta_formula::destroy () invalidates every
+ * session that still refers to the released formulas. A collection
+ * only keeps the formulas of the current session, so it is only run
+ * while no other session is alive, see nondeter_checker::collect ().
+ */
+
+#ifndef SOLVER_SESSION_H
+#define SOLVER_SESSION_H
+
+#include "nondeter_checker.h"
+#include "scc.h"
+#include "progression/nondeter_prog_state.h"
+#include "formula/sat_context.h"
+#include <mutex>
+
+class solver_session 
+{
+  public:
+    solver_session ();
+    ~solver_session ();
+    void activate ();   //make this session the current one of the calling thread
+    void reset ();      //drop all state, the next check starts from scratch
+    //mark the formulas the session uses for aalta_formula::end_collection ();
+    //the SAT context forgets the formulas that are not marked otherwise
+    void mark ();
+    static solver_session& current ();
+    
+  private:
+    friend class nondeter_checker;
+    friend class nondeter_prog_state;
+    friend class scc_transition;
+    friend class scc_state;
+    friend class sat_context;
+    
+    nondeter_checker::session_data *_checker;
+    nondeter_prog_state::session_data *_prog_states;
+    scc_transition::session_data *_scc_transitions;
+    scc_state::session_data *_scc_states;
+    sat_context::session_data *_sat;
+    
+    void create ();
+    void release ();
+    
+    solver_session (const solver_session&);
+    solver_session& operator = (const solver_session&);
+    
+    static thread_local solver_session *_current;
+    static int _alive;              //sessions of the process
+    static std::mutex _alive_lock;  //held while a session is created or released, and by a collection
+};
+
+#endif
@@ -0,0 +1,275 @@
+/* 
+ * Trace symmetry of a formula
+ * 
+ * File:   symmetry.cpp
+ */
+ 
+ #include "symmetry.h"
+ #include "util/utility.h"
+ #include <algorithm>
+ 
+ using namespace std;
+ 
+ symmetry::symmetry ()
+ {
+   _group.push_back (atom_map ());
+ }
+ 
+ void 
+ symmetry::set_traces (const vector<string>& traces)
+ {
+   _traces = traces;
+ }
+ 
+ //the proposition and the trace of the atom name prop_trace
+ bool 
+ symmetry::split (const string& name, string& prop, string& trace) const
+ {
+   size_t pos;
+   if (_traces.empty ())
+     pos = name.rfind ('_');
+   else
+   {
+     int i = trace_of (name, _traces);
+     pos = i < 0 ? string::npos : name.size () - _traces[i].size () - 1;
+   }
+   if (pos == string::npos || pos == 0)
+     return false;
+   prop = name.substr (0, pos);
+   trace = name.substr (pos + 1);
+   return true;
+ }
+ 
+ //the atom a_x of f mapped to a_y and a_y to a_x
+ symmetry::atom_map 
+ symmetry::swap (aalta_formula *f, const string& x, const string& y) const
+ {
+   atom_map res;
+   aalta_formula::af_prt_set alphabet = f->get_alphabet ();
+   for (aalta_formula::af_prt_set::iterator it = alphabet.begin (); it != alphabet.end (); it ++)
+   {
+     aalta_formula *atom = (*it)->oper () == aalta_formula::Not ? (*it)->r_af () : *it;
+     string prop, trace;
+     if (!split (aalta_formula::get_name (atom->oper ()), prop, trace))
+       continue;
+     if (trace == x)
+       res[atom->oper ()] = aalta_formula::atom_id (prop + "_" + y);
+     else if (trace == y)
+       res[atom->oper ()] = aalta_formula::atom_id (prop + "_" + x);
+   }
+   return res;
+ }
+ 
+ bool 
+ symmetry::invariant (aalta_formula *f, const atom_map& m)
+ {
+   hash_map<aalta_formula *, aalta_formula *, aalta_formula::af_prt_hash> done;
+   return normalize (f->rename (m, done)).f == normalize (f).f;
+ }
+ 
+ bool 
+ symmetry::normal_form::operator < (const normal_form& nf) const
+ {
+   if (hash != nf.hash)
+     return hash < nf.hash;
+   return f->id () < nf.f->id ();
+ }
+ 
+ //the normal forms of the operands of nested op (& or |) formulas
+ void 
+ symmetry::operands (int op, aalta_formula *f, std::vector<normal_form>& res)
+ {
+   if (f->oper () == op)
+   {
+     operands (op, f->l_af (), res);
+     operands (op, f->r_af (), res);
+   }
+   else
+     res.push_back (normalize (f));
+ }
+ 
+ //operands of & and | sorted by their hash, ties by id; equal hashes of
+ //different formulas only cost a missed match
+ symmetry::normal_form 
+ symmetry::normalize (aalta_formula *f)
+ {
+   normal_map::iterator it = _normal.find (f);
+   if (it != _normal.end ())
+     return it->second;
+   normal_form res;
+   int op = f->oper ();
+   if (op > aalta_formula::Undefined)
+   {
+     res.f = f;
+     res.hash = HASH_INIT;
+     string name = aalta_formula::get_name (op);
+     for (int i = 0; i < name.size (); i ++)
+       res.hash = (res.hash << 5) ^ (res.hash >> 27) ^ name[i];
+   }
+   else if (op == aalta_formula::And || op == aalta_formula::Or)
+   {
+     vector<normal_form> ops;
+     operands (op, f, ops);
+     sort (ops.begin (), ops.end ());
+     res.f = ops.back ().f;
+     res.hash = ((size_t) HASH_INIT << 5) ^ op;
+     for (int i = ops.size () - 2; i >= 0; i --)
+     {
+       if (ops[i].f != ops[i+1].f)
+         res.f = aalta_formula (op, ops[i].f, res.f).unique ();
+     }
+     for (int i = 0; i < ops.size (); i ++)
+       res.hash = (res.hash << 5) ^ (res.hash >> 27) ^ ops[i].hash;
+   }
+   else
+   {
+     normal_form l, r;
+     l.f = r.f = NULL;
+     l.hash = r.hash = 0;
+     if (f->l_af () != NULL)
+       l = normalize (f->l_af ());
+     if (f->r_af () != NULL)
+       r = normalize (f->r_af ());
+     res.f = (l.f == f->l_af () && r.f == f->r_af ()) ? f : aalta_formula (op, l.f, r.f).unique ();
+     res.hash = ((((size_t) HASH_INIT << 5) ^ op) * 31 + l.hash) * 31 + r.hash;
+   }
+   _normal[f] = res;
+   return res;
+ }
+ 
+ //add the permutations of traces to the group if f is invariant under
+ //them; the adjacent transpositions generate all of them
+ void 
+ symmetry::extend (aalta_formula *f, const vector<string>& traces)
+ {
+   if (traces.size () < 2)
+     return;
+   vector<atom_map> swaps;
+   for (int i = 0; i + 1 < traces.size (); i ++)
+   {
+     swaps.push_back (swap (f, traces[i], traces[i+1]));
+     if (!invariant (f, swaps.back ()))
+       return;
+   }
+   
+   //closure of the group under the new transpositions
+   vector<atom_map> group = _group;
+   for (int i = 0; i < group.size (); i ++)
+   {
+     for (int j = 0; j < swaps.size (); j ++)
+     {
+       atom_map g = group[i];
+       for (atom_map::iterator it = swaps[j].begin (); it != swaps[j].end (); it ++)
+       {
+         //g after the swap: a -> g (swap (a))
+         atom_map::iterator git = group[i].find (it->second);
+         g[it->first] = git == group[i].end () ? it->second : git->second;
+       }
+       for (atom_map::iterator it = g.begin (); it != g.end (); )
+       {
+         if (it->first == it->second)
+           g.erase (it ++);
+         else
+           it ++;
+       }
+       bool found = false;
+       for (int k = 0; k < group.size () && !found; k ++)
+         found = (group[k] == g);
+       if (!found)
+       {
+         if (group.size () >= MAX_GROUP)
+           return;
+         group.push_back (g);
+       }
+     }
+   }
+   _group = group;
+ }
+ 
+ void 
+ symmetry::discover (aalta_formula *f)
+ {
+   //traces with the same propositions, in order of first appearance
+   map<string, vector<string> > props;
+   vector<string> traces;
+   aalta_formula::af_prt_set alphabet = f->get_alphabet ();
+   for (aalta_formula::af_prt_set::iterator it = alphabet.begin (); it != alphabet.end (); it ++)
+   {
+     aalta_formula *atom = (*it)->oper () == aalta_formula::Not ? (*it)->r_af () : *it;
+     string prop, trace;
+     if (!split (aalta_formula::get_name (atom->oper ()), prop, trace))
+       continue;
+     if (props.find (trace) == props.end ())
+       traces.push_back (trace);
+     props[trace].push_back (prop);
+   }
+   map<vector<string>, vector<string> > classes;
+   vector<vector<string> > order;
+   for (int i = 0; i < traces.size (); i ++)
+   {
+     vector<string>& p = props[traces[i]];
+     sort (p.begin (), p.end ());
+     p.erase (unique (p.begin (), p.end ()), p.end ());
+     if (classes.find (p) == classes.end ())
+       order.push_back (p);
+     classes[p].push_back (traces[i]);
+   }
+   for (int i = 0; i < order.size (); i ++)
+     extend (f, classes[order[i]]);
+ }
+ 
+ void 
+ symmetry::add_class (aalta_formula *f, const vector<string>& traces)
+ {
+   if (_traces.empty ())
+     _traces = traces;
+   extend (f, traces);
+ }
+ 
+ aalta_formula* 
+ symmetry::canonical (aalta_formula *f)
+ {
+   if (trivial ())
+     return f;
+   formula_map::iterator it = _canonical.find (f);
+   if (it != _canonical.end ())
+     return it->second;
+   aalta_formula *res = normalize (f).f;
+   for (int i = 1; i < _group.size (); i ++)
+   {
+     hash_map<aalta_formula *, aalta_formula *, aalta_formula::af_prt_hash> done;
+     aalta_formula *g = normalize (f->rename (_group[i], done)).f;
+     if (g->id () < res->id ())
+       res = g;
+   }
+   _canonical[f] = res;
+   return res;
+ }
+ 
+ //the cached results of the formulas that are not marked are dropped; a
+ //representative that is kept stays the one with the smallest id of its
+ //orbit, since a formula built again later gets a larger id
+ void 
+ symmetry::forget_unmarked ()
+ {
+   for (formula_map::iterator it = _canonical.begin (); it != _canonical.end (); )
+   {
+     if (aalta_formula::marked (it->first))
+     {
+       aalta_formula::mark (it->second);
+       it ++;
+     }
+     else
+       it = _canonical.erase (it);
+   }
+   for (normal_map::iterator it = _normal.begin (); it != _normal.end (); )
+   {
+     if (aalta_formula::marked (it->first))
+     {
+       aalta_formula::mark (it->second.f);
+       it ++;
+     }
+     else
+       it = _normal.erase (it);
+   }
+ }
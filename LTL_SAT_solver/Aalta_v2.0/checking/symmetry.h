@@ -0,0 +1,68 @@
+/* 
+ * Trace symmetry of a formula
+ * 
+ * File:   symmetry.h
+ * 
+ * Formulas instantiated from HyperLTL bodies use the atoms a_x
+ * (proposition a on trace x). Exchanging traces renames atoms; if the
+ * input is invariant under a group of such renamings, the search meets
+ * many states that are equal up to a renaming. canonical () maps every
+ * state of an orbit to the same representative: the renamings are
+ * brought into a normal form modulo commutativity of & and | (the
+ * operand order of the unique formulas follows their ids), and the one
+ * with the smallest id is taken.
+ */
+
+#ifndef SYMMETRY_H
+#define SYMMETRY_H
+
+#include "formula/aalta_formula.h"
+#include <map>
+#include <string>
+#include <vector>
+
+class symmetry 
+{
+  public:
+    symmetry ();
+    //the trace variables the atom names end in, see trace_of (); without
+    //them the trace of an atom is what follows its last '_', or one of
+    //the traces given to add_class ()
+    void set_traces (const std::vector<std::string>&);
+    //find the classes of interchangeable traces of f from the atom names
+    void discover (aalta_formula*);
+    //declare the traces as interchangeable, used if f is invariant
+    void add_class (aalta_formula*, const std::vector<std::string>&);
+    bool trivial () const { return _group.size () <= 1; }
+    int size () const { return _group.size (); }
+    aalta_formula* canonical (aalta_formula*);
+    //called by a collection once the formulas in use are marked
+    void forget_unmarked ();
+    
+  private:
+    typedef std::map<int, int> atom_map;
+    typedef hash_map<aalta_formula*, aalta_formula*, aalta_formula::af_prt_hash> formula_map;
+    enum { MAX_GROUP = 120 };   //5 interchangeable traces
+    
+    struct normal_form
+    {
+      aalta_formula *f;
+      size_t hash;    //does not depend on the operand order of & and |
+      bool operator < (const normal_form&) const;
+    };
+    typedef hash_map<aalta_formula*, normal_form, aalta_formula::af_prt_hash> normal_map;
+    
+    std::vector<atom_map> _group;   //all renamings, the identity first
+    std::vector<std::string> _traces;
+    formula_map _canonical;
+    normal_map _normal;
+    
+    bool split (const std::string&, std::string&, std::string&) const;
+    atom_map swap (aalta_formula*, const std::string&, const std::string&) const;
+    bool invariant (aalta_formula*, const atom_map&);
+    void extend (aalta_formula*, const std::vector<std::string>&);
+    normal_form normalize (aalta_formula*);
+    void operands (int, aalta_formula*, std::vector<normal_form>&);
+};
+
+#endif
@@ -6,6 +6,7 @@
  */
 
 #include "aalta_formula.h"
+#include "sat_context.h"
 #include "../util/utility.h"
 #include "../ltlparser/trans.h"
 
@@ -24,11 +25,15 @@ using namespace Minisat;
 ///////////////////////////////////////////
 // 开始静态部分
 /* 初始化静态变量 */
-std::vector<std::string> aalta_formula::names;
+std::string *aalta_formula::names[NAME_CHUNKS];
+std::atomic<int> aalta_formula::names_size (0);
 hash_map<std::string, int> aalta_formula::ids;
+std::mutex aalta_formula::names_lock;
 //aalta_formula::af_prt_map aalta_formula::all_afs;
-aalta_formula::afp_set aalta_formula::all_afs;
+aalta_formula::af_shard aalta_formula::all_afs[AF_SHARDS];
 aalta_formula::tag_set aalta_formula::all_tags;
+arena<aalta_formula::tag_t> aalta_formula::tag_arena;
+std::mutex aalta_formula::tags_lock;
 aalta_formula *aalta_formula::_TRUE = NULL;
 aalta_formula *aalta_formula::_FALSE = NULL;
 
@@ -61,51 +66,256 @@ aalta_formula::FALSE ()
  * @param index
  * @return 
  */
-std::string
+const std::string&
 aalta_formula::get_name (int index)
 {
-  return names[index];
+  if (names_size.load (std::memory_order_acquire) == 0)
+    {
+      std::lock_guard<std::mutex> guard (names_lock);
+      init_names ();
+    }
+  return names[index / NAME_CHUNK][index % NAME_CHUNK];
+}
+
+/**
+ * 按顺序填入操作符的名称, 原子变量的id从Undefined + 1开始
+ * names_lock must be held.
+ */
+void
+aalta_formula::init_names ()
+{
+  if (names_size.load (std::memory_order_relaxed) == 0)
+    {
+      add_name ("true");
+      add_name ("false");
+      add_name ("Literal");
+      add_name ("!");
+      add_name ("|");
+      add_name ("&");
+      add_name ("X");
+      add_name ("N"); //weak Next, for LTLf
+      add_name ("U");
+      add_name ("R");
+      add_name ("Undefined");
+    }
+}
+
+/**
+ * 在names末尾追加一个名称, 写好之后才发布新的个数
+ * names_lock must be held.
+ */
+void
+aalta_formula::add_name (const std::string& name)
+{
+  int n = names_size.load (std::memory_order_relaxed);
+  if (n == NAME_CHUNK * NAME_CHUNKS)
+    {
+      print_error ("too many atoms!");
+      exit (1);
+    }
+  if (n % NAME_CHUNK == 0)
+    names[n / NAME_CHUNK] = new std::string[NAME_CHUNK];
+  names[n / NAME_CHUNK][n % NAME_CHUNK] = name;
+  names_size.store (n + 1, std::memory_order_release);
+}
+
+/**
+ * 获取变量名对应的id, 此变量名未出现过时添加之
+ * @param name
+ * @return 
+ */
+int
+aalta_formula::atom_id (const std::string& name)
+{
+  std::lock_guard<std::mutex> guard (names_lock);
+  init_names ();
+  hash_map<std::string, int>::const_iterator it = ids.find (name);
+  if (it != ids.end ())
+    return it->second;
+  int id = names_size.load (std::memory_order_relaxed);
+  ids[name] = id;
+  add_name (name);
+  return id;
 }
 
 /**
  * 销毁静态变量, 释放资源
+ * The unique formulas and the tags live in arenas and are released in bulk.
  */
 void
 aalta_formula::destroy ()
 {
-  std::list<tag_t *> l;
-  for (tag_set::iterator it = all_tags.begin (); it != all_tags.end (); it++)
-    l.push_back (*it);
-  for (std::list<tag_t *>::iterator it = l.begin (); it != l.end (); it++)
-    delete *it;
-  all_tags.clear ();
+  all_tags = tag_set ();
+  tag_arena.clear ();
   //  for (af_prt_map::iterator it = all_afs.begin (); it != all_afs.end (); it++)
   //    delete it->second;
 
-  for (afp_set::iterator it = all_afs.begin (); it != all_afs.end (); it ++)
+  for (int i = 0; i < AF_SHARDS; i ++)
   {
-    //if ((*it) == NULL)
-      //printf ("i=%d, address=%d\n", i, (int)(*it));
-    delete (*it);
-
+    all_afs[i].afs = afp_set ();
+    all_afs[i].nodes.clear ();
+  }
+  sat_context::reset ();
+  _until_map = hash_map<aalta_formula*, aalta_formula *, af_prt_hash> ();
+  _var_until_map = hash_map<aalta_formula*, aalta_formula *, af_prt_hash> ();
+  _max_id = 0;
+  _reclaimed = 0;
+  {
+    std::lock_guard<std::mutex> guard (names_lock);
+    ids.clear ();
+    for (int i = 0; i < NAME_CHUNKS && names[i] != NULL; i ++)
+    {
+      delete[] names[i];
+      names[i] = NULL;
+    }
+    names_size = 0;
   }
-  all_afs.clear ();
-  ids.clear ();
-  names.clear ();
   _TRUE = NULL;
   _FALSE = NULL;
 }
 
+int aalta_formula::_epoch = 0;
+int aalta_formula::_first_collected = 0;
+std::atomic<int> aalta_formula::_reclaimed (0);
+std::vector<aalta_formula *> aalta_formula::_gray;
+std::mutex aalta_formula::collection_lock;
+
+/**
+ * 开始一次回收, 之后mark ()所有仍在使用的公式
+ * No other thread may use the formulas until end_collection (); two
+ * collections run one after the other. The formulas with ids below
+ * first, the tags, TRUE, FALSE and the until variables are kept, as is
+ * everything they refer to.
+ * @param first 可以被释放的最小id
+ */
+void
+aalta_formula::begin_collection (int first)
+{
+  collection_lock.lock ();
+  _epoch ++;
+  _first_collected = first;
+  for (int i = 0; i < AF_SHARDS; i ++)
+  {
+    for (afp_set::iterator it = all_afs[i].afs.begin (); it != all_afs[i].afs.end (); it ++)
+      if ((*it)->_id < first)
+        mark (*it);
+  }
+  for (tag_set::iterator it = all_tags.begin (); it != all_tags.end (); it ++)
+  {
+    for (tag_t::iterator tit = (*it)->begin (); tit != (*it)->end (); tit ++)
+      mark (*tit);
+  }
+  for (hash_map<aalta_formula*, aalta_formula *, af_prt_hash>::iterator it = _until_map.begin (); it != _until_map.end (); it ++)
+  {
+    mark (it->first);
+    mark (it->second);
+  }
+  mark (_TRUE);
+  mark (_FALSE);
+}
+
+/**
+ * 标记af及其引用的所有公式: 子公式, 化简结果和缓存的flatted, to_set, get_alphabet
+ */
+void
+aalta_formula::mark (aalta_formula *af)
+{
+  if (af == NULL || af->_mark == _epoch)
+    return;
+  af->_mark = _epoch;
+  _gray.push_back (af);
+  while (!_gray.empty ())
+  {
+    aalta_formula *f = _gray.back ();
+    _gray.pop_back ();
+    aalta_formula *refs[] = {f->_left, f->_right, f->_simp, f->_flatted.load ()};
+    for (int i = 0; i < 4; i ++)
+    {
+      if (refs[i] != NULL && refs[i]->_mark != _epoch)
+      {
+        refs[i]->_mark = _epoch;
+        _gray.push_back (refs[i]);
+      }
+    }
+    af_prt_set *sets[] = {f->_set.load (), f->_alphabet.load ()};
+    for (int i = 0; i < 2; i ++)
+    {
+      if (sets[i] == NULL)
+        continue;
+      for (af_prt_set::iterator it = sets[i]->begin (); it != sets[i]->end (); it ++)
+      {
+        if ((*it)->_mark != _epoch)
+        {
+          (*it)->_mark = _epoch;
+          _gray.push_back (*it);
+        }
+      }
+    }
+  }
+}
+
+void
+aalta_formula::mark (const af_prt_set& afs)
+{
+  for (af_prt_set::const_iterator it = afs.begin (); it != afs.end (); it ++)
+    mark (*it);
+}
+
+/**
+ * 释放未被标记的公式, 其位置由之后的unique ()重用
+ * The ids of the released formulas are not handed out again.
+ * @return 释放的公式个数
+ */
+int
+aalta_formula::end_collection ()
+{
+  int released = 0;
+  std::vector<aalta_formula *> dead;
+  for (int i = 0; i < AF_SHARDS; i ++)
+  {
+    std::lock_guard<std::mutex> guard (all_afs[i].lock);
+    dead.clear ();
+    for (afp_set::iterator it = all_afs[i].afs.begin (); it != all_afs[i].afs.end (); it ++)
+      if ((*it)->_id >= _first_collected && (*it)->_mark != _epoch)
+        dead.push_back (*it);
+    for (int j = 0; j < dead.size (); j ++)
+      all_afs[i].afs.erase (dead[j]);
+    for (int j = 0; j < dead.size (); j ++)
+      all_afs[i].nodes.release (dead[j]);
+    released += dead.size ();
+  }
+  _reclaimed += released;
+  collection_lock.unlock ();
+  return released;
+}
+
 void 
 aalta_formula::print_all_formulas ()
 {
 
+  afp_set afs = all_formulas ();
   afp_set::iterator it;
-  for (it = all_afs.begin (); it != all_afs.end (); it ++)
+  for (it = afs.begin (); it != afs.end (); it ++)
     printf ("%s : address=%p\n", (*it)->to_string ().c_str (), (*it));
     
 }
 
+/**
+ * 所有分片中的唯一公式
+ * @return 
+ */
+aalta_formula::afp_set 
+aalta_formula::all_formulas ()
+{
+  afp_set afs;
+  for (int i = 0; i < AF_SHARDS; i ++)
+  {
+    std::lock_guard<std::mutex> guard (all_afs[i].lock);
+    afs.insert (all_afs[i].afs.begin (), all_afs[i].afs.end ());
+  }
+  return afs;
+}
+
 /**
  * 判断af是否与集合中的元素互斥, 即是否存在 a 和 !a
  * @param af
@@ -363,7 +573,7 @@ aalta_formula::simplify_or (aalta_formula *l, aalta_formula *r)
     ret = aalta_formula::FALSE ();
   else
     {
-      std::sort (afp, afp + n);
+      std::sort (afp, afp + n, compare ()); // 按创建顺序(_id)排序, 与内存地址无关
       int i, j;
       //a | b R a = a;
       //a | b U a = b U a;
@@ -445,7 +655,7 @@ aalta_formula::simplify_and (aalta_formula *l, aalta_formula *r)
     ret = aalta_formula::TRUE ();
   else
     {
-      std::sort (afp, afp + n);
+      std::sort (afp, afp + n, compare ()); // 按创建顺序(_id)排序, 与内存地址无关
       int i, j;
       for (i = 0, j = 1; j < n; ++j)
         if (afp[i] != afp[j]) // 去重
@@ -559,6 +769,31 @@ aalta_formula::simplify_and_weak (aalta_formula *l, aalta_formula *r)
   return NULL;
 }
 
+/**
+ * 把afs中的公式用op (And或Or)连接而不做化简. 嵌套的op会被展开, 子公式
+ * 按_id排序去重后右结合, 即与simplify_and/simplify_or的结果同形, 所以
+ * 只差结合律和交换律的集合得到同一个节点; afs为空时返回NULL
+ * @param op
+ * @param afs
+ * @return 
+ */
+aalta_formula *
+aalta_formula::merge (int op, const af_prt_set& afs)
+{
+  std::list<aalta_formula *> af_list;
+  for (af_prt_set::const_iterator it = afs.begin (); it != afs.end (); it++)
+    (*it)->split (op, af_list);
+  if (af_list.empty ())
+    return NULL;
+  std::vector<aalta_formula *> afv (af_list.begin (), af_list.end ());
+  std::sort (afv.begin (), afv.end (), compare ()); // 按创建顺序(_id)排序
+  afv.erase (std::unique (afv.begin (), afv.end ()), afv.end ());
+  aalta_formula *ret = afv.back ();
+  for (int i = (int) afv.size () - 2; i >= 0; --i)
+    ret = aalta_formula (op, afv[i], ret).unique ();
+  return ret;
+}
+
 /**
  * 合并两个formula而不做化简
  * @param af1
@@ -705,23 +940,12 @@ inline void
 aalta_formula::init ()
 {
   _left = _right = _unique = _simp = NULL;
+  _flatted.store (NULL, std::memory_order_relaxed);
+  _set.store (NULL, std::memory_order_relaxed);
+  _alphabet.store (NULL, std::memory_order_relaxed);
   _tag = NULL;
   _op = Undefined;
   _length = 0;
-  if (names.empty ())
-    { //按顺序
-      names.push_back ("true");
-      names.push_back ("false");
-      names.push_back ("Literal");
-      names.push_back ("!");
-      names.push_back ("|");
-      names.push_back ("&");
-      names.push_back ("X");
-      names.push_back ("N"); //weak Next, for LTLf
-      names.push_back ("U");
-      names.push_back ("R");
-      names.push_back ("Undefined");
-    }
 }
 
 /**
@@ -750,12 +974,14 @@ aalta_formula::aalta_formula ()
 }
 
 aalta_formula::aalta_formula (const aalta_formula& orig)
+: _flatted (NULL), _set (NULL), _alphabet (NULL)
 {
   *this = orig;
 }
 
 aalta_formula::aalta_formula (int op, aalta_formula *left, aalta_formula *right, tag_t *tag)
-: _op (op), _tag (tag), _length (0), _unique (NULL), _simp (NULL)
+: _op (op), _length (0), _tag (tag), _unique (NULL), _simp (NULL),
+  _flatted (NULL), _set (NULL), _alphabet (NULL)
 {
 /*
   //modified by Jianwen Li for construction of of and cf fromulas
@@ -879,26 +1105,17 @@ aalta_formula::aalta_formula (unsigned index)
   init ();
   std::string str = std::string ("var") + convert_to_string (index);
   
-  int id;
-  hash_map<std::string, int>::const_iterator it = ids.find (str);
-  if (it == ids.end ())
-    { // 此变量名未出现过，添加之
-      id = names.size ();
-      ids[str] = id;
-      names.push_back (str);
-    }
-  else
-    {
-      id = it->second;
-    }
-  _op = id;
+  _op = atom_id (str);
   
   _left = NULL;
   _right = NULL;
   clc_hash ();
 }
 
-aalta_formula::~aalta_formula () { }
+aalta_formula::~aalta_formula ()
+{
+  clear_cache ();
+}
 
 aalta_formula * 
 aalta_formula::nnf ()
@@ -983,6 +1200,7 @@ aalta_formula& aalta_formula::operator = (const aalta_formula& af)
       this->_length = af._length;
       this->_unique = af._unique;
       this->_simp = af._simp;
+      clear_cache ();
     }
   return *this;
 }
@@ -1116,20 +1334,41 @@ aalta_formula::build (const ltl_formula *formula, bool is_not, bool is_ltlf)
 inline void
 aalta_formula::build_atom (const char *name, bool is_not)
 {
-  int id;
-  hash_map<std::string, int>::const_iterator it = ids.find (name);
-  if (it == ids.end ())
-    { // 此变量名未出现过，添加之
-      id = names.size ();
-      ids[name] = id;
-      names.push_back (name);
+  int id = atom_id (name);
+  if (is_not) _op = Not, _right = aalta_formula (id, NULL, NULL).unique ();
+  else _op = id;
+}
+
+/**
+ * 按atoms (原id -> 新id) 替换原子变量, 用于HyperLTL的trace变量实例化.
+ * done记录已处理的子公式; 不含被替换原子的子公式原样返回, 因此各副本
+ * 共享这些子公式. 只用于unique的公式
+ * @param atoms
+ * @param done
+ * @return 
+ */
+aalta_formula *
+aalta_formula::rename (const std::map<int, int>& atoms, hash_map<aalta_formula *, aalta_formula *, af_prt_hash>& done)
+{
+  hash_map<aalta_formula *, aalta_formula *, af_prt_hash>::const_iterator it = done.find (this);
+  if (it != done.end ())
+    return it->second;
+  aalta_formula *res = this;
+  if (_op > Undefined)
+    {
+      std::map<int, int>::const_iterator ait = atoms.find (_op);
+      if (ait != atoms.end ())
+        res = aalta_formula (ait->second, NULL, NULL).unique ();
     }
   else
     {
-      id = it->second;
+      aalta_formula *l = _left == NULL ? NULL : _left->rename (atoms, done);
+      aalta_formula *r = _right == NULL ? NULL : _right->rename (atoms, done);
+      if (l != _left || r != _right)
+        res = aalta_formula (_op, l, r, _tag).unique ();
     }
-  if (is_not) _op = Not, _right = aalta_formula (id, NULL, NULL).unique ();
-  else _op = id;
+  done[this] = res;
+  return res;
 }
 
 aalta_formula *
@@ -1142,14 +1381,17 @@ aalta_formula::classify (tag_t *tag)
       tag = new tag_t ();
     }
   aalta_formula ret = *this;
-  tag_set::iterator iter = all_tags.find (tag);
-  if (iter == all_tags.end ())
-    {
-      ret._tag = new tag_t (*tag);
-      all_tags.insert (ret._tag);
-    }
-  else
-    ret._tag = *iter;
+  {
+    std::lock_guard<std::mutex> guard (tags_lock);
+    tag_set::iterator iter = all_tags.find (tag);
+    if (iter == all_tags.end ())
+      {
+        ret._tag = tag_arena.create (*tag);
+        all_tags.insert (ret._tag);
+      }
+    else
+      ret._tag = *iter;
+  }
   if (ret._left != NULL)
     ret._left = ret._left->classify (tag);
   bool until = false;
@@ -1473,10 +1715,13 @@ aalta_formula::clone () const
   return new_formula;
 }
 
-int aalta_formula::_max_id = 0;
+std::atomic<int> aalta_formula::_max_id (0);
 
 /**
  * 返回该aalta_formula对应的唯一指针
+ * Only the shard of the formula's hash is locked, so threads building
+ * unrelated formulas do not wait for each other. The ids are handed out
+ * in creation order and never change.
  * @return 
  */
 aalta_formula *
@@ -1484,15 +1729,18 @@ aalta_formula::unique ()
 {
   if (_unique == NULL)
     {
-      afp_set::const_iterator iter = all_afs.find (this);
-      if (iter != all_afs.end ())
+      af_shard& shard = all_afs[_hash % AF_SHARDS];
+      std::lock_guard<std::mutex> guard (shard.lock);
+      afp_set::const_iterator iter = shard.afs.find (this);
+      if (iter != shard.afs.end ())
         _unique = (*iter);
       else
         {
         
-          _unique = clone ();
+          _unique = shard.nodes.create (*this);
           _unique->_id = _max_id ++;
-          all_afs.insert (_unique);
+          _unique->_mark = 0;
+          shard.afs.insert (_unique);
           
           //all_afs.insert (_unique = clone ());
           _unique->_unique = _unique;
@@ -1517,10 +1765,10 @@ std::string
 aalta_formula::to_RPN () const
 {
   if (_left == NULL && _right == NULL)
-    return names[_op];
+    return get_name (_op);
   if (_left != NULL && _right != NULL)
-    return names[_op] + " " + _left->to_RPN () + " " + _right->to_RPN ();
-  return names[_op] + " " + (_left == NULL ? _right->to_RPN () : _left->to_RPN ());
+    return get_name (_op) + " " + _left->to_RPN () + " " + _right->to_RPN ();
+  return get_name (_op) + " " + (_left == NULL ? _right->to_RPN () : _left->to_RPN ());
 }
 
 /**
@@ -1531,12 +1779,12 @@ std::string
 aalta_formula::to_string () const
 {
   if (_left == NULL && _right == NULL)
-    return names[_op];// + "[" + convert_to_string(_id) + "]";
+    return get_name (_op);// + "[" + convert_to_string(_id) + "]";
   if (_left == NULL)
-    return "(" + names[_op] + " " + _right->to_string () + ")";// + "[" + convert_to_string(_id) + "]";
+    return "(" + get_name (_op) + " " + _right->to_string () + ")";// + "[" + convert_to_string(_id) + "]";
   if (_right == NULL)
-    return "(" + _left->to_string () + " " + names[_op] + ")";// + "[" + convert_to_string(_id) + "]";
-  return "(" + _left->to_string () + " " + names[_op] + " " + _right->to_string () + ")";// + "[" + convert_to_string(_id) + "]";
+    return "(" + _left->to_string () + " " + get_name (_op) + ")";// + "[" + convert_to_string(_id) + "]";
+  return "(" + _left->to_string () + " " + get_name (_op) + " " + _right->to_string () + ")";// + "[" + convert_to_string(_id) + "]";
 }
 
 
@@ -1739,12 +1987,11 @@ aalta_formula::cf()
 bool 
 aalta_formula::model(aalta_formula *af)
 {
-  af_prt_set P = af->to_set();
-  return model(P);
+  return model(af->to_set());
 }
 
 bool 
-aalta_formula::model(af_prt_set P)
+aalta_formula::model(const af_prt_set& P)
 {
   switch(oper())
   {
@@ -1780,7 +2027,7 @@ aalta_formula::model(af_prt_set P)
 
 //formula progression algorithm
 aalta_formula*
-aalta_formula::progf(af_prt_set P)
+aalta_formula::progf(const af_prt_set& P)
 {
   aalta_formula *result = NULL, *until = NULL, *l = NULL, *r = NULL;
   switch(oper())
@@ -1884,6 +2131,7 @@ aalta_formula::progf(af_prt_set P)
 
 hash_map<aalta_formula*, aalta_formula *, aalta_formula::af_prt_hash> aalta_formula::_until_map;
 hash_map<aalta_formula*, aalta_formula *, aalta_formula::af_prt_hash> aalta_formula::_var_until_map;
+std::mutex aalta_formula::until_lock;
 
 aalta_formula* 
 aalta_formula::get_var ()
@@ -1893,16 +2141,34 @@ aalta_formula::get_var ()
      printf ("aalta_formula::get_var: the formula is not Until!\n");
      exit (0);
   }
+  {
+    std::lock_guard<std::mutex> guard (until_lock);
+    hash_map<aalta_formula*, aalta_formula*, af_prt_hash>::iterator it;
+    it = _until_map.find (this);
+    if (it != _until_map.end ())
+      return it->second;
+  }
+  {
+    aalta_formula *res = mark_until ();
+    return res;
+    //printf ("aalta_formula::get_var: Cannot find the variable for the until formula\n%s\n", to_string().c_str ());
+    //exit (0);
+  }
+  return NULL;
+}
+
+aalta_formula* 
+aalta_formula::find_var ()
+{
+  std::lock_guard<std::mutex> guard (until_lock);
   hash_map<aalta_formula*, aalta_formula*, af_prt_hash>::iterator it;
   it = _until_map.find (this);
   if (it != _until_map.end ())
     return it->second;
   else
   {
-    aalta_formula *res = mark_until ();
-    return res;
-    //printf ("aalta_formula::get_var: Cannot find the variable for the until formula\n%s\n", to_string().c_str ());
-    //exit (0);
+    printf ("aalta_formula::find_var: the until formula is not found in _until_map!\n");
+    exit (0);
   }
   return NULL;
 }
@@ -1910,6 +2176,7 @@ aalta_formula::get_var ()
 aalta_formula* 
 aalta_formula::get_until ()
 {
+  std::lock_guard<std::mutex> guard (until_lock);
   hash_map<aalta_formula*, aalta_formula*, af_prt_hash>::iterator it;
   it = _var_until_map.find (this);
   if (it != _var_until_map.end ())
@@ -1931,6 +2198,7 @@ aalta_formula::mark_until ()
      exit (0);
   }
   aalta_formula *result;
+  std::lock_guard<std::mutex> guard (until_lock);
   hash_map<aalta_formula*, aalta_formula*, af_prt_hash, af_prt_eq>::iterator it;
   it = _until_map.find (this);
   if (it != _until_map.end ())
@@ -1940,18 +2208,7 @@ aalta_formula::mark_until ()
     std::string name = "FOR_UNTIL_";
     int pos = _until_map.size ();
     name += convert_to_string (pos);
-    hash_map<std::string, int>::const_iterator it = ids.find (name);
-    int id;
-    if (it == ids.end ())
-    { // the variable is not exisited
-      id = names.size ();
-      ids[name] = id;
-      names.push_back (name);
-    }
-    else
-    {
-      id = it->second;
-    }
+    int id = atom_id (name);
     result = aalta_formula (id, NULL, NULL).unique ();
     _until_map.insert (pair<aalta_formula*, aalta_formula*> (this, result));
     _var_until_map.insert (pair<aalta_formula*, aalta_formula*> (result, this));
@@ -1959,37 +2216,6 @@ aalta_formula::mark_until ()
   return result;
 }
 
-bool 
-aalta_formula::model_until (aalta_formula::af_prt_set P)
-{
-  hash_map<aalta_formula*, aalta_formula *, af_prt_hash>::iterator it;
-  switch (oper ())
-  {
-    case Until:
-      it = _until_map.find (this);
-      if (it == _until_map.end ())
-      {
-        printf ("aalta_formula::model_until: the until formula is not found in _until_map!\n");
-        exit (0);
-      }
-      if (P.find (it->second) != P.end ())
-        return true;
-      else 
-        return false;
-    case Release:
-      return true;
-    case And:
-      return _left->model_until (P) && _right->model_until (P);
-    case Or:
-      return _left->model_until (P) || _right->model_until (P);
-    case Undefined:
-      return false;
-    default:
-      return true;
-  }
-  return false;
-}
-
 aalta_formula::af_prt_set 
 aalta_formula::get_until_flags ()
 {
@@ -2005,7 +2231,7 @@ aalta_formula::get_until_flags ()
   {
     if (oper () > Undefined)
     {
-      string str = names[oper ()];
+      const string& str = get_name (oper ());
       if (str.find ("FOR_UNTIL_") != string::npos)
         result.insert (this);
     }
@@ -2032,7 +2258,7 @@ aalta_formula::normal ()
   {
     if (oper () > Undefined)
     {
-      string str = names[oper ()];
+      const string& str = get_name (oper ());
       if (str.find ("FOR_UNTIL_") != string::npos)
         result = TRUE ();
       else
@@ -2049,7 +2275,7 @@ aalta_formula::is_until_marked ()
 {
   if (oper () <= Undefined)
     return false;
-  string str = names[oper ()];
+  const string& str = get_name (oper ());
   if (str.find ("FOR_UNTIL_") != string::npos)
     return true;
   else
@@ -2060,6 +2286,13 @@ aalta_formula*
 aalta_formula::flatted ()
 {
   aalta_formula *result, *l, *r, *nx, *until, *not_until;
+  result = _flatted.load ();
+  if (result != NULL)
+  {
+    _cache_hits ++;
+    return result;
+  }
+  _cache_misses ++;
   switch (oper ())
   {
     case Until:
@@ -2142,13 +2375,14 @@ aalta_formula::flatted ()
     default:
       result = this;
   }
+  _flatted = result;
   return result;
 }
 
 bool 
-aalta_formula::contain (af_prt_set P1, af_prt_set P2)
+aalta_formula::contain (const af_prt_set& P1, const af_prt_set& P2)
 {
-  af_prt_set::iterator it;
+  af_prt_set::const_iterator it;
   for (it = P2.begin (); it != P2.end (); it ++)
   {
     if (P1.find (*it) == P1.end ())
@@ -2158,12 +2392,54 @@ aalta_formula::contain (af_prt_set P1, af_prt_set P2)
 }
 
 
-int aalta_formula::_sat_count = 0;
+std::atomic<int> aalta_formula::_sat_count (0);
 
 void 
 aalta_formula::print_sat_count ()
 {
-  printf ("Total SAT invoking: %d\n", _sat_count);
+  printf ("Total SAT invoking: %d\n", _sat_count.load ());
+}
+
+std::atomic<long> aalta_formula::_cache_hits (0);
+std::atomic<long> aalta_formula::_cache_misses (0);
+
+void 
+aalta_formula::print_cache_count ()
+{
+  printf ("Derived formula cache: %ld hits, %ld misses\n", _cache_hits.load (), _cache_misses.load ());
+}
+
+/**
+ * 把新计算的集合P存入cache; 若其他线程已先存入, 则丢弃P
+ * @return the cached set
+ */
+const aalta_formula::af_prt_set& 
+aalta_formula::cache_set (std::atomic<af_prt_set *>& cache, af_prt_set *P)
+{
+  af_prt_set *expected = NULL;
+  if (!cache.compare_exchange_strong (expected, P))
+  {
+    delete P;
+    return *expected;
+  }
+  return *P;
+}
+
+//only for formulas no other thread can see (destruction and assignment)
+void 
+aalta_formula::clear_cache ()
+{
+  _flatted.store (NULL, std::memory_order_relaxed);
+  if (_set.load (std::memory_order_relaxed) != NULL)
+  {
+    delete _set.load (std::memory_order_relaxed);
+    _set.store (NULL, std::memory_order_relaxed);
+  }
+  if (_alphabet.load (std::memory_order_relaxed) != NULL)
+  {
+    delete _alphabet.load (std::memory_order_relaxed);
+    _alphabet.store (NULL, std::memory_order_relaxed);
+  }
 }
 
 aalta_formula::af_prt_set 
@@ -2235,1084 +2511,53 @@ aalta_formula::erase_next_global (aalta_formula::af_prt_set& P)
 aalta_formula::af_prt_set 
 aalta_formula::SAT_core()
 {
-  af_prt_set P;
-  _sat_count ++;
-  int_prt_map prop_map;
-  int var_num;
-  Minisat::Solver S;
-  
-  /*
-  std::vector<std::vector<int> > cls = toDIMACS (prop_map);
-  int var;
-  for (int i = 0; i < cls.size (); i ++)
-  {
-    vec<Lit> lits;
-    for (int j = 0; j < cls[i].size (); j ++)
-    {
-      //printf ("%d ", cls[i][j]);
-      assert (cls[i][j] != 0); 
-      var = abs(cls[i][j])-1;
-      while (var >= S.nVars()) S.newVar();
-      if (cls[i][j] > 0)
-        lits.push (mkLit (var));
-      else
-        lits.push (~mkLit (var));
-    }
-    //printf ("\n");
-    S.addClause_(lits);
-  */
-  
-  
-  int cls[MAX_CL][3];
-  int cls_num = 0;
-  toDIMACS (prop_map, cls, cls_num);
-  
-  //printf ("SAT formula is\n%s\n", to_string().c_str ());
-  
-  int var;
-  for (int i = 0; i < cls_num; i ++)
+  return sat_context::solve (this);
+}
+
+bool 
+aalta_formula::find (aalta_formula *f)
+{
+  switch (oper ())
   {
-    vec<Lit> lits;
-    for (int j = 0; j < 3; j ++)
-    {
-      //printf ("%d ", cls[i][j]);
-      if (cls[i][j] == 0)   break; 
-      var = abs(cls[i][j])-1;
-      while (var >= S.nVars()) S.newVar();
-      if (cls[i][j] > 0)
-        lits.push (mkLit (var));
+    case And:
+    case Or:
+      return _left->find (f) || _right->find (f);
+    default:
+      if (this == f)
+        return true;
       else
-        lits.push (~mkLit (var));
-    }
-    //printf ("\n");
-    S.addClause_(lits);
-  }
-  
-  
-  if (!S.simplify())
-  {
-    return P;             //false
-  }
-  Minisat::vec<Minisat::Lit> dummy;
-  Minisat::lbool ret;
-  ret = S.solveLimited(dummy);
-  
-  //handle the result from Minisat
-  if(ret == l_True)
-  {
-
-    int_prt_map::iterator it;
-
-    for(int i = 0; i < S.nVars(); i++)
-    {
-      it = prop_map.find (i+1);
-      if(it != prop_map.end())
-      {
-        if(S.model[i] == l_True)
-          P.insert (it->second);
-        else
-          P.insert (aalta_formula (Not, NULL, it->second).unique ());
-      }
-
-    }
+        return false;
   }
- 
-  return P;
+  return false;
 }
 
 void 
-aalta_formula::toDIMACS(int_prt_map& prop_map, int (&cls)[MAX_CL][3], int& cls_num)
+aalta_formula::to_set (af_prt_set & result)
 {
-  int var_num = 1;
-  int cl_num = 1;
-  af_int_map int_map;
-  if(oper() != And && oper() != Or)
+  if(oper() != And)
   {
-    if(oper () == Not)
-    {
-      assert (_right->oper () != And && _right->oper () != Or);
-      prop_map[1] = _right;
-      //return "p cnf 1 1 \n-1 0\n";
-      cls[cls_num][0] = -1;
-      cls[cls_num][1] = 0;
-      cls_num ++;
-    }
-    else
-    {
-      prop_map[1] = this;
-      //return "p cnf 1 1 \n1 0\n";
-      cls[cls_num][0] = 1;
-      cls[cls_num][1] = 0;
-      cls_num ++;
-    }
+    result.insert(this);
   }
   else
   {
-    if (oper () == Not)
-    {
-      cls[cls_num][0] = -1;
-      cls[cls_num][1] = 0;
-      cls_num ++;
-    }
-    else
-    {
-      cls[cls_num][0] = 1;
-      cls[cls_num][1] = 0;
-      cls_num ++;
-    }
-    
-    plus(prop_map, int_map, var_num, cl_num, 1, cls, cls_num);
-
+    _left->to_set(result);
+    _right->to_set(result);
   }
 }
 
-std::vector<std::vector<int> > 
-aalta_formula::toDIMACS(int_prt_map& prop_map)
+const aalta_formula::af_prt_set& 
+aalta_formula::to_set()
 {
-  std::vector<std::vector<int> > res;
-  std::vector<int> lits;
-  int var_num = 1;
-  int cl_num = 1;
-  af_int_map int_map;
-  if(oper() != And && oper() != Or)
+  af_prt_set *result = _set.load ();
+  if (result != NULL)
   {
-    if(oper () == Not)
-    {
-      assert (_right->oper () != And && _right->oper () != Or);
-      prop_map[1] = _right;
-      //return "p cnf 1 1 \n-1 0\n";
-      lits.push_back (-1);
-      lits.push_back (0);
-      res.push_back (lits);
-      return res;
-    }
-    else
-    {
-      prop_map[1] = this;
-      //return "p cnf 1 1 \n1 0\n";
-      lits.push_back (1);
-      lits.push_back (0);
-      res.push_back (lits);
-      return res;
-    }
-  }
-  else
-  {
-    //std::string result = "";
-    //result = plus(prop_map, int_map, var_num, cl_num, 1);
-    std::vector<int> lits;
-    if (oper () == Not)
-    {
-      lits.push_back (-1);
-      res.push_back (lits);
-    }
-    else
-    {
-      lits.push_back (1);
-      res.push_back (lits);
-    }
-    
-    plus(prop_map, int_map, var_num, cl_num, 1, res);
-    /*
-    if (oper () == Not)
-      result = "p cnf " + convert_to_string(var_num) + " " + convert_to_string(cl_num) + "\n-1 0\n" + result;
-    else
-      result = "p cnf " + convert_to_string(var_num) + " " + convert_to_string(cl_num) + "\n1 0\n" + result;
-    return result;
-    */
-    return res;
-  }
-}
-
-int 
-aalta_formula::search(aalta_formula af, af_int_map& int_map, int& var_num)
-{
-  int result;
-  af_int_map::iterator it = int_map.find(af);
-  if(it != int_map.end())
-  {
-    result = it->second;
-  }
-  else
-  {
-    result = ++var_num;
-    int_map[af] = result;
-  }
-  return result;
-}
-
-void 
-aalta_formula::plus(int_prt_map& prop_map, af_int_map& int_map, int& var_num, int& cl_num, int cur, int (&cls)[MAX_CL][3], int &cls_num)
-{
-  
-  int findex, f1index, f2index;
-  findex = cur;
-  //std::string result = "";
-  switch (oper ())
-  {
-    case Not:
-    {
-      //result = _right->minus (prop_map, int_map, var_num, cl_num, findex);
-      _right->minus (prop_map, int_map, var_num, cl_num, findex, cls, cls_num);
-      break;
-    }
-    case And:
-    {
-      switch (_left->oper ())
-      {
-        case Not:
-          if (_left->_right->oper () == And || _left->_right->oper () == Or)
-            f1index = ++var_num;
-          else if (_left->_right->oper () == Not)
-          {
-            printf ("Error: two Not together in aalta_formula::TODAMICS-AND\n");
-            exit (0);
-          }
-          else
-          {
-            f1index = search (*(_left->_right), int_map, var_num);
-            prop_map[f1index] = _left->_right;
-          }
-          f1index = -f1index;
-          break;
-        case And:
-        case Or:
-          f1index = ++var_num;
-          break;
-        default:
-          f1index = search (*_left, int_map, var_num);
-          prop_map[f1index] = _left;
-          break;
-      }
-      
-      switch (_right->oper ())
-      {
-        case Not:
-          if (_right->_right->oper () == And || _right->_right->oper () == Or)
-            f2index = ++var_num;
-          else if (_right->_right->oper () == Not)
-          {
-            printf ("Error: two Not together in aalta_formula::TODIMACS-AND\n");
-            exit (0);
-          }
-          else
-          {
-            f2index = search (*(_right->_right), int_map, var_num);
-            prop_map[f2index] = _right->_right;
-          }
-
-          f2index = -f2index;
-          break;
-        case And:
-        case Or:
-          f2index = ++var_num;
-          break;
-        default:
-          f2index = search (*_right, int_map, var_num);
-          prop_map[f2index] = _right;
-          break;
-      }
-      
-      //result = convert_to_string(-findex) + " " + convert_to_string(f1index) + " 0\n" 
-      //         + convert_to_string(-findex) + " " + convert_to_string(f2index) + " 0\n";
-      cls[cls_num][0] = -findex;
-      cls[cls_num][1] = f1index;
-      cls[cls_num][2] = 0;
-      cls_num ++;
-      assert (cls_num < MAX_CL);
-      
-      cls[cls_num][0] = -findex;
-      cls[cls_num][1] = f2index;
-      cls[cls_num][2] = 0;
-      cls_num ++;
-      assert (cls_num < MAX_CL);
-      
-      /*
-      int ints[] = {-findex, f1index};
-      std::vector<int> lits (ints, ints + sizeof (ints)/sizeof (int));
-      //lits.push_back (-findex);
-      //lits.push_back (f1index);
-      res.push_back (lits);
-      int ints2[] = {-findex, f2index};
-      std::vector<int> lits2 (ints2, ints2 + sizeof (ints2)/sizeof (int));
-      //lits2.push_back (-findex);
-      //lits2.push_back (f2index);
-      res.push_back (lits2);
-      */
-      
-      cl_num += 2;
-      //result += _left->plus (prop_map, int_map, var_num, cl_num, f1index);
-      //result += _right->plus (prop_map, int_map, var_num, cl_num, f2index);
-      _left->plus (prop_map, int_map, var_num, cl_num, f1index, cls, cls_num);
-      _right->plus (prop_map, int_map, var_num, cl_num, f2index, cls, cls_num);
-      break;
-    }  
-    case Or:
-    {
-      switch (_left->oper ())
-      {
-        case Not:
-          if (_left->_right->oper () == And || _left->_right->oper () == Or)
-            f1index = ++var_num;
-          else if (_left->_right->oper () == Not)
-          {
-            printf ("Error: two Not together in aalta_formula::TODAMICS-OR\n");
-            exit (0);
-          }
-          else
-          {
-            f1index = search (*(_left->_right), int_map, var_num);
-            prop_map[f1index] = _left->_right;
-          }
-          f1index = -f1index;
-          break;
-        case And:
-        case Or:
-          f1index = ++var_num;
-          break;
-        default:
-          f1index = search (*_left, int_map, var_num);
-          prop_map[f1index] = _left;
-          break;
-      }
-      
-      switch (_right->oper ())
-      {
-        case Not:
-          if (_right->_right->oper () == And || _right->_right->oper () == Or)
-            f2index = ++var_num;
-          else if (_right->_right->oper () == Not)
-          {
-            printf ("Error: two Not together in aalta_formula::TODAMICS-OR\n");
-            exit (0);
-          }
-          else
-          {
-            f2index = search (*(_right->_right), int_map, var_num);
-            prop_map[f2index] = _right->_right;
-          }
-
-          f2index = -f2index;
-          break;
-        case And:
-        case Or:
-          f2index = ++var_num;
-          break;
-        default:
-          f2index = search (*_right, int_map, var_num);
-          prop_map[f2index] = _right;
-          break;
-      }
-      
-      //result = convert_to_string(-findex) + " " + convert_to_string(f1index) + " "
-      //         + convert_to_string(f2index) + " 0\n" ;
-      cls[cls_num][0] = -findex;
-      cls[cls_num][1] = f1index;
-      cls[cls_num][2] = f2index;
-      cls_num ++;
-      assert (cls_num < MAX_CL);
-      
-      /*
-      int ints[] = {-findex, f1index, f2index};
-      std::vector<int> lits (ints, ints + sizeof (ints)/sizeof (int));
-      //lits.push_back (-findex);
-      //lits.push_back (f1index);
-      //lits.push_back (f2index);
-      res.push_back (lits);
-      */
-      
-      cl_num += 1;
-      //result += _left->plus (prop_map, int_map, var_num, cl_num, f1index);
-      //result += _right->plus (prop_map, int_map, var_num, cl_num, f2index);
-      _left->plus (prop_map, int_map, var_num, cl_num, f1index, cls, cls_num);
-      _right->plus (prop_map, int_map, var_num, cl_num, f2index, cls, cls_num);
-      break;
-    }
-    default:
-      break;
-      
-  }
-  //return result;
-}
-
-//std::string 
-void 
-aalta_formula::minus (int_prt_map& prop_map, af_int_map& int_map, int& var_num, int& cl_num, int cur, int (&cls)[MAX_CL][3], int &cls_num)
-{
-  int findex, f1index, f2index;
-  findex = cur;
-  std::string result = "";
-  switch (oper ())
-  {
-    case Not:
-      //result = _right->plus (prop_map, int_map, var_num, cl_num, findex);
-      _right->plus (prop_map, int_map, var_num, cl_num, findex, cls, cls_num);
-      break;
-    case And:
-    {
-      switch (_left->oper ())
-      {
-        case Not:
-          if (_left->_right->oper () == And || _left->_right->oper () == Or)
-            f1index = ++var_num;
-          else if (_left->_right->oper () == Not)
-          {
-            printf ("Error: two Not together in aalta_formula::TODAMICS-AND\n");
-            exit (0);
-          }
-          else
-          {
-            f1index = search (*(_left->_right), int_map, var_num);
-            prop_map[f1index] = _left->_right;
-          }
-          //f1index = -f1index;
-          break;
-        case And:
-        case Or:
-          f1index = ++var_num;
-          f1index = -f1index;
-          break;
-        default:
-          f1index = search (*_left, int_map, var_num);
-          prop_map[f1index] = _left;
-          f1index = -f1index;
-          break;
-      }
-      
-      switch (_right->oper ())
-      {
-        case Not:
-          if (_right->_right->oper () == And || _right->_right->oper () == Or)
-            f2index = ++var_num;
-          else if (_right->_right->oper () == Not)
-          {
-            printf ("Error: two Not together in aalta_formula::TODIMACS-AND\n");
-            exit (0);
-          }
-          else
-          {
-            f2index = search (*(_right->_right), int_map, var_num);
-            prop_map[f2index] = _right->_right;
-          }
-
-          //f2index = -f2index;
-          break;
-        case And:
-        case Or:
-          f2index = ++var_num;
-          f2index = -f2index;
-          break;
-        default:
-          f2index = search (*_right, int_map, var_num);
-          prop_map[f2index] = _right;
-          f2index = -f2index;
-          break;
-      }
-      
-      //result = convert_to_string(-findex) + " " + convert_to_string(f1index) + " "
-      //         + convert_to_string(f2index) + " 0\n" ;
-      
-      cls[cls_num][0] = -findex;
-      cls[cls_num][1] = f1index;
-      cls[cls_num][2] = f2index;
-      cls_num ++;
-      assert (cls_num < MAX_CL);
-      
-      /*
-      int ints[] = {-findex, f1index, f2index};
-      std::vector<int> lits (ints, ints + sizeof (ints)/sizeof (int));
-      //lits.push_back (-findex);
-      //lits.push_back (f1index);
-      //lits.push_back (f2index);
-      res.push_back (lits);
-      */
-      
-      cl_num += 1;
-      //result += _left->minus (prop_map, int_map, var_num, cl_num, f1index);
-      //result += _right->minus (prop_map, int_map, var_num, cl_num, f2index);
-      _left->minus (prop_map, int_map, var_num, cl_num, f1index, cls, cls_num);
-      _right->minus (prop_map, int_map, var_num, cl_num, f2index, cls, cls_num);
-      break;
-    }  
-    case Or:
-    {
-      switch (_left->oper ())
-      {
-        case Not:
-          if (_left->_right->oper () == And || _left->_right->oper () == Or)
-            f1index = ++var_num;
-          else if (_left->_right->oper () == Not)
-          {
-            printf ("Error: two Not together in aalta_formula::TODAMICS-OR\n");
-            exit (0);
-          }
-          else
-          {
-            f1index = search (*(_left->_right), int_map, var_num);
-            prop_map[f1index] = _left->_right;
-          }
-          //f1index = -f1index;
-          break;
-        case And:
-        case Or:
-          f1index = ++var_num;
-          f1index = -f1index;
-          break;
-        default:
-          f1index = search (*_left, int_map, var_num);
-          prop_map[f1index] = _left;
-          f1index = -f1index;
-          break;
-      }
-      
-      switch (_right->oper ())
-      {
-        case Not:
-          if (_right->_right->oper () == And || _right->_right->oper () == Or)
-            f2index = ++var_num;
-          else if (_right->_right->oper () == Not)
-          {
-            printf ("Error: two Not together in aalta_formula::TODAMICS-OR\n");
-            exit (0);
-          }
-          else
-          {
-            f2index = search (*(_right->_right), int_map, var_num);
-            prop_map[f2index] = _right->_right;
-          }
-
-          //f2index = -f2index;
-          break;
-        case And:
-        case Or:
-          f2index = ++var_num;
-          f2index = -f2index;
-          break;
-        default:
-          f2index = search (*_right, int_map, var_num);
-          prop_map[f2index] = _right;
-          f2index = -f2index;
-          break;
-      }
-      
-      cls[cls_num][0] = -findex;
-      cls[cls_num][1] = -f1index;
-      cls[cls_num][2] = f2index;
-      cls_num ++;
-      assert (cls_num < MAX_CL);
-      
-      cls[cls_num][0] = -findex;
-      cls[cls_num][1] = f1index;
-      cls[cls_num][2] = -f2index;
-      cls_num ++;
-      assert (cls_num < MAX_CL);
-      
-      cls[cls_num][0] = -findex;
-      cls[cls_num][1] = f1index;
-      cls[cls_num][2] = f2index;
-      cls_num ++;
-      assert (cls_num < MAX_CL);
-      
-      /*
-      int ints[] = {-findex, -f1index, f2index};
-      std::vector<int> lits (ints, ints + sizeof (ints)/sizeof (int));
-      //lits.push_back (-findex);
-      //lits.push_back (-f1index);
-      //lits.push_back (f2index);
-      res.push_back (lits);
-      int ints2[] = {-findex, f1index, -f2index};
-      std::vector<int> lits2 (ints2, ints2 + sizeof (ints2)/sizeof (int));
-      //lits2.push_back (-findex);
-      //lits2.push_back (f1index);
-      //lits2.push_back (-f2index);
-      res.push_back (lits2);
-      int ints3[] = {-findex, f1index, f2index};
-      std::vector<int> lits3 (ints3, ints3 + sizeof(ints3)/sizeof(int));
-      //lits3.push_back (-findex);
-      //lits3.push_back (f1index);
-      //lits3.push_back (f2index);
-      res.push_back (lits3);
-      */
-       
-      cl_num += 3;
-      //result += _left->minus (prop_map, int_map, var_num, cl_num, f1index);
-      //result += _right->minus (prop_map, int_map, var_num, cl_num, f2index);
-      _left->minus (prop_map, int_map, var_num, cl_num, f1index, cls, cls_num);
-      _right->minus (prop_map, int_map, var_num, cl_num, f2index, cls, cls_num);
-      break;
-    }
-    default:
-      break;
-      
+    _cache_hits ++;
+    return *result;
   }
-  //return result;
-}
-
-
-void 
-aalta_formula::plus(int_prt_map& prop_map, af_int_map& int_map, int& var_num, int& cl_num, int cur, std::vector<std::vector<int> >& res)
-{
-  
-  int findex, f1index, f2index;
-  findex = cur;
-  //std::string result = "";
-  switch (oper ())
-  {
-    case Not:
-    {
-      //result = _right->minus (prop_map, int_map, var_num, cl_num, findex);
-      _right->minus (prop_map, int_map, var_num, cl_num, findex, res);
-      break;
-    }
-    case And:
-    {
-      switch (_left->oper ())
-      {
-        case Not:
-          if (_left->_right->oper () == And || _left->_right->oper () == Or)
-            f1index = ++var_num;
-          else if (_left->_right->oper () == Not)
-          {
-            printf ("Error: two Not together in aalta_formula::TODAMICS-AND\n");
-            exit (0);
-          }
-          else
-          {
-            f1index = search (*(_left->_right), int_map, var_num);
-            prop_map[f1index] = _left->_right;
-          }
-          f1index = -f1index;
-          break;
-        case And:
-        case Or:
-          f1index = ++var_num;
-          break;
-        default:
-          f1index = search (*_left, int_map, var_num);
-          prop_map[f1index] = _left;
-          break;
-      }
-      
-      switch (_right->oper ())
-      {
-        case Not:
-          if (_right->_right->oper () == And || _right->_right->oper () == Or)
-            f2index = ++var_num;
-          else if (_right->_right->oper () == Not)
-          {
-            printf ("Error: two Not together in aalta_formula::TODIMACS-AND\n");
-            exit (0);
-          }
-          else
-          {
-            f2index = search (*(_right->_right), int_map, var_num);
-            prop_map[f2index] = _right->_right;
-          }
-
-          f2index = -f2index;
-          break;
-        case And:
-        case Or:
-          f2index = ++var_num;
-          break;
-        default:
-          f2index = search (*_right, int_map, var_num);
-          prop_map[f2index] = _right;
-          break;
-      }
-      
-      //result = convert_to_string(-findex) + " " + convert_to_string(f1index) + " 0\n" 
-      //         + convert_to_string(-findex) + " " + convert_to_string(f2index) + " 0\n";
-      int ints[] = {-findex, f1index};
-      std::vector<int> lits (ints, ints + sizeof (ints)/sizeof (int));
-      //lits.push_back (-findex);
-      //lits.push_back (f1index);
-      res.push_back (lits);
-      int ints2[] = {-findex, f2index};
-      std::vector<int> lits2 (ints2, ints2 + sizeof (ints2)/sizeof (int));
-      //lits2.push_back (-findex);
-      //lits2.push_back (f2index);
-      res.push_back (lits2);
-      
-      cl_num += 2;
-      //result += _left->plus (prop_map, int_map, var_num, cl_num, f1index);
-      //result += _right->plus (prop_map, int_map, var_num, cl_num, f2index);
-      _left->plus (prop_map, int_map, var_num, cl_num, f1index, res);
-      _right->plus (prop_map, int_map, var_num, cl_num, f2index, res);
-      break;
-    }  
-    case Or:
-    {
-      switch (_left->oper ())
-      {
-        case Not:
-          if (_left->_right->oper () == And || _left->_right->oper () == Or)
-            f1index = ++var_num;
-          else if (_left->_right->oper () == Not)
-          {
-            printf ("Error: two Not together in aalta_formula::TODAMICS-OR\n");
-            exit (0);
-          }
-          else
-          {
-            f1index = search (*(_left->_right), int_map, var_num);
-            prop_map[f1index] = _left->_right;
-          }
-          f1index = -f1index;
-          break;
-        case And:
-        case Or:
-          f1index = ++var_num;
-          break;
-        default:
-          f1index = search (*_left, int_map, var_num);
-          prop_map[f1index] = _left;
-          break;
-      }
-      
-      switch (_right->oper ())
-      {
-        case Not:
-          if (_right->_right->oper () == And || _right->_right->oper () == Or)
-            f2index = ++var_num;
-          else if (_right->_right->oper () == Not)
-          {
-            printf ("Error: two Not together in aalta_formula::TODAMICS-OR\n");
-            exit (0);
-          }
-          else
-          {
-            f2index = search (*(_right->_right), int_map, var_num);
-            prop_map[f2index] = _right->_right;
-          }
-
-          f2index = -f2index;
-          break;
-        case And:
-        case Or:
-          f2index = ++var_num;
-          break;
-        default:
-          f2index = search (*_right, int_map, var_num);
-          prop_map[f2index] = _right;
-          break;
-      }
-      
-      //result = convert_to_string(-findex) + " " + convert_to_string(f1index) + " "
-      //         + convert_to_string(f2index) + " 0\n" ;
-      int ints[] = {-findex, f1index, f2index};
-      std::vector<int> lits (ints, ints + sizeof (ints)/sizeof (int));
-      //lits.push_back (-findex);
-      //lits.push_back (f1index);
-      //lits.push_back (f2index);
-      res.push_back (lits);
-      
-      cl_num += 1;
-      //result += _left->plus (prop_map, int_map, var_num, cl_num, f1index);
-      //result += _right->plus (prop_map, int_map, var_num, cl_num, f2index);
-      _left->plus (prop_map, int_map, var_num, cl_num, f1index, res);
-      _right->plus (prop_map, int_map, var_num, cl_num, f2index, res);
-      break;
-    }
-    default:
-      break;
-      
-  }
-  //return result;
-}
-
-//std::string 
-void 
-aalta_formula::minus (int_prt_map& prop_map, af_int_map& int_map, int& var_num, int& cl_num, int cur, std::vector<std::vector<int> >& res)
-{
-  int findex, f1index, f2index;
-  findex = cur;
-  std::string result = "";
-  switch (oper ())
-  {
-    case Not:
-      //result = _right->plus (prop_map, int_map, var_num, cl_num, findex);
-      _right->plus (prop_map, int_map, var_num, cl_num, findex, res);
-      break;
-    case And:
-    {
-      switch (_left->oper ())
-      {
-        case Not:
-          if (_left->_right->oper () == And || _left->_right->oper () == Or)
-            f1index = ++var_num;
-          else if (_left->_right->oper () == Not)
-          {
-            printf ("Error: two Not together in aalta_formula::TODAMICS-AND\n");
-            exit (0);
-          }
-          else
-          {
-            f1index = search (*(_left->_right), int_map, var_num);
-            prop_map[f1index] = _left->_right;
-          }
-          //f1index = -f1index;
-          break;
-        case And:
-        case Or:
-          f1index = ++var_num;
-          f1index = -f1index;
-          break;
-        default:
-          f1index = search (*_left, int_map, var_num);
-          prop_map[f1index] = _left;
-          f1index = -f1index;
-          break;
-      }
-      
-      switch (_right->oper ())
-      {
-        case Not:
-          if (_right->_right->oper () == And || _right->_right->oper () == Or)
-            f2index = ++var_num;
-          else if (_right->_right->oper () == Not)
-          {
-            printf ("Error: two Not together in aalta_formula::TODIMACS-AND\n");
-            exit (0);
-          }
-          else
-          {
-            f2index = search (*(_right->_right), int_map, var_num);
-            prop_map[f2index] = _right->_right;
-          }
-
-          //f2index = -f2index;
-          break;
-        case And:
-        case Or:
-          f2index = ++var_num;
-          f2index = -f2index;
-          break;
-        default:
-          f2index = search (*_right, int_map, var_num);
-          prop_map[f2index] = _right;
-          f2index = -f2index;
-          break;
-      }
-      
-      //result = convert_to_string(-findex) + " " + convert_to_string(f1index) + " "
-      //         + convert_to_string(f2index) + " 0\n" ;
-      int ints[] = {-findex, f1index, f2index};
-      std::vector<int> lits (ints, ints + sizeof (ints)/sizeof (int));
-      //lits.push_back (-findex);
-      //lits.push_back (f1index);
-      //lits.push_back (f2index);
-      res.push_back (lits);
-      
-      cl_num += 1;
-      //result += _left->minus (prop_map, int_map, var_num, cl_num, f1index);
-      //result += _right->minus (prop_map, int_map, var_num, cl_num, f2index);
-      _left->minus (prop_map, int_map, var_num, cl_num, f1index, res);
-      _right->minus (prop_map, int_map, var_num, cl_num, f2index, res);
-      break;
-    }  
-    case Or:
-    {
-      switch (_left->oper ())
-      {
-        case Not:
-          if (_left->_right->oper () == And || _left->_right->oper () == Or)
-            f1index = ++var_num;
-          else if (_left->_right->oper () == Not)
-          {
-            printf ("Error: two Not together in aalta_formula::TODAMICS-OR\n");
-            exit (0);
-          }
-          else
-          {
-            f1index = search (*(_left->_right), int_map, var_num);
-            prop_map[f1index] = _left->_right;
-          }
-          //f1index = -f1index;
-          break;
-        case And:
-        case Or:
-          f1index = ++var_num;
-          f1index = -f1index;
-          break;
-        default:
-          f1index = search (*_left, int_map, var_num);
-          prop_map[f1index] = _left;
-          f1index = -f1index;
-          break;
-      }
-      
-      switch (_right->oper ())
-      {
-        case Not:
-          if (_right->_right->oper () == And || _right->_right->oper () == Or)
-            f2index = ++var_num;
-          else if (_right->_right->oper () == Not)
-          {
-            printf ("Error: two Not together in aalta_formula::TODAMICS-OR\n");
-            exit (0);
-          }
-          else
-          {
-            f2index = search (*(_right->_right), int_map, var_num);
-            prop_map[f2index] = _right->_right;
-          }
-
-          //f2index = -f2index;
-          break;
-        case And:
-        case Or:
-          f2index = ++var_num;
-          f2index = -f2index;
-          break;
-        default:
-          f2index = search (*_right, int_map, var_num);
-          prop_map[f2index] = _right;
-          f2index = -f2index;
-          break;
-      }
-      
-      //result = convert_to_string(-findex) + " " + convert_to_string(-f1index) + " "
-      //         + convert_to_string(f2index) + " 0\n" ;
-      //result += convert_to_string(-findex) + " " + convert_to_string(f1index) + " "
-      //         + convert_to_string(-f2index) + " 0\n" ;
-      //result += convert_to_string(-findex) + " " + convert_to_string(f1index) + " "
-      //         + convert_to_string(f2index) + " 0\n" ;
-      int ints[] = {-findex, -f1index, f2index};
-      std::vector<int> lits (ints, ints + sizeof (ints)/sizeof (int));
-      //lits.push_back (-findex);
-      //lits.push_back (-f1index);
-      //lits.push_back (f2index);
-      res.push_back (lits);
-      int ints2[] = {-findex, f1index, -f2index};
-      std::vector<int> lits2 (ints2, ints2 + sizeof (ints2)/sizeof (int));
-      //lits2.push_back (-findex);
-      //lits2.push_back (f1index);
-      //lits2.push_back (-f2index);
-      res.push_back (lits2);
-      int ints3[] = {-findex, f1index, f2index};
-      std::vector<int> lits3 (ints3, ints3 + sizeof(ints3)/sizeof(int));
-      //lits3.push_back (-findex);
-      //lits3.push_back (f1index);
-      //lits3.push_back (f2index);
-      res.push_back (lits3);
-             
-      cl_num += 3;
-      //result += _left->minus (prop_map, int_map, var_num, cl_num, f1index);
-      //result += _right->minus (prop_map, int_map, var_num, cl_num, f2index);
-      _left->minus (prop_map, int_map, var_num, cl_num, f1index, res);
-      _right->minus (prop_map, int_map, var_num, cl_num, f2index, res);
-      break;
-    }
-    default:
-      break;
-      
-  }
-  //return result;
-}
-
-aalta_formula::af_prt_set 
-aalta_formula::get_prop(std::string dimacs, int_prt_map prop_map)
-{
-  af_prt_set result;
-  std::string line;
-  int val;
-  
-  aalta_formula* f;
-  std::vector<std::string> strs;
-  ifstream fileout;
-  fileout.open(dimacs.c_str());
-  if(fileout.is_open())
-  {
-    std::getline(fileout, line);
-    if(line.find("UNSAT") != std::string::npos)
-    {
-      return result;
-    }
-    else
-    {
-      if(line.find("SAT") != std::string::npos)
-      {
-        std::getline(fileout, line);
-        strs = split_str(line);
-        int size = strs.size();
-        for(int i = 0; i < size; i ++)
-        {
-          if(strs[i].at(0) == '0')
-          {
-            continue;
-          }
-          if(strs[i].at(0) != '-')
-          {
-            val = atoi(strs[i].c_str());
-            f = prop_map[val];
-            if(f->oper() > Undefined)
-              result.insert(f);
-          }
-          else
-          {
-            val = atoi(strs[i].substr(1).c_str());
-            f = prop_map[val];
-            if(f->oper() > Undefined)
-            {
-              f = aalta_formula(Not, NULL, f).unique();
-              result.insert(f);
-            }
-          }
-        }
-      }
-      else
-      {
-        cout << "minisat computing error!" << endl;
-        exit(0);
-      }
-    }
-  }
-  else
-  {
-    cout << "Unable to open file " << dimacs << endl;
-    exit(0);
-  }
-  return result;
-}
-
-bool 
-aalta_formula::find (aalta_formula *f)
-{
-  switch (oper ())
-  {
-    case And:
-    case Or:
-      return _left->find (f) || _right->find (f);
-    default:
-      if (this == f)
-        return true;
-      else
-        return false;
-  }
-  return false;
-}
-
-void 
-aalta_formula::to_set (af_prt_set & result)
-{
-  if(oper() != And)
-  {
-    result.insert(this);
-  }
-  else
-  {
-    _left->to_set(result);
-    _right->to_set(result);
-  }
-}
-
-aalta_formula::af_prt_set 
-aalta_formula::to_set()
-{
-  af_prt_set result;
-  to_set (result);
-  return result;
+  _cache_misses ++;
+  result = new af_prt_set;
+  to_set (*result);
+  return cache_set (_set, result);
   /*
   af_prt_set result, result1, result2;
   if(oper() != And)
@@ -3352,10 +2597,17 @@ aalta_formula::and_to_set()
   return result;
 }
 
-aalta_formula::af_prt_set 
+const aalta_formula::af_prt_set& 
 aalta_formula::get_alphabet()
 {
-  af_prt_set result, P;
+  af_prt_set *result = _alphabet.load ();
+  if (result != NULL)
+  {
+    _cache_hits ++;
+    return *result;
+  }
+  _cache_misses ++;
+  result = new af_prt_set;
   std::string str = "";
   switch (oper ())
   {
@@ -3364,23 +2616,25 @@ aalta_formula::get_alphabet()
       break;
     case Not:
     case Next:
-      result = _right->get_alphabet ();
+      *result = _right->get_alphabet ();
       break;
     case And:
     case Or:
     case Until:
     case Release:
-      P = _left->get_alphabet ();
-      result.insert (P.begin (), P.end ());
-      P = _right->get_alphabet ();
-      result.insert (P.begin (), P.end ());
+      {
+        const af_prt_set& L = _left->get_alphabet ();
+        result->insert (L.begin (), L.end ());
+        const af_prt_set& R = _right->get_alphabet ();
+        result->insert (R.begin (), R.end ());
+      }
       break;
     default:
       str = get_name (oper ());
       if (str.find ("FOR_UNTIL_") == std::string::npos)
-        result.insert (this);
+        result->insert (this);
   }
-  return result;
+  return cache_set (_alphabet, result);
   /*
   int size = names.size();
   if(size < Undefined + 2)
@@ -3545,7 +2799,8 @@ aalta_formula::cosafety2smv ()
   int i = 0;
   afp_set::iterator it;
   afp_set atoms;
-  for(it = all_afs.begin(); it != all_afs.end(); it ++)
+  afp_set afs = all_formulas ();
+  for(it = afs.begin(); it != afs.end(); it ++)
   {
     switch((*it)->_op)
     {
@@ -3581,7 +2836,7 @@ aalta_formula::cosafety2smv ()
   result += "TRANS\n";
   string l, r, cur;
   hash_map<aalta_formula*, int>::iterator it_map;
-  for(it = all_afs.begin(); it != all_afs.end(); it ++)
+  for(it = afs.begin(); it != afs.end(); it ++)
   {
     switch((*it)->_op)
     {
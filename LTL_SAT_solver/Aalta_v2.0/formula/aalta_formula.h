@@ -15,14 +15,17 @@
 #include "../util/define.h"
 #include "../util/hash_map.h"
 #include "../util/hash_set.h"
+#include "../util/arena.h"
 #include "../ltlparser/ltl_formula.h"
 
 #include <list>
 #include <vector>
 #include <string>
 #include <set>
+#include <map>
+#include <mutex>
+#include <atomic>
 
-#define MAX_CL 100000
 
 class aalta_formula
 {
@@ -32,27 +35,17 @@ private:
   //成员变量//
   //////////////////////////////////////////////////
   int _op; // 操作符
+  int _length; //公式长度
   aalta_formula *_left; // 操作符左端公式
   aalta_formula *_right; // 操作符右端公式
   tag_t *_tag; // 标签，相对于Until的位置信息
   size_t _hash; // hash值
-  int _length; //公式长度
   aalta_formula *_unique; // 指向唯一指针标识
   aalta_formula *_simp; // 指向化简后的公式指针
   //////////////////////////////////////////////////
 
 public:
 
-  /* af公式的hash函数 */
-  struct af_hash
-  {
-
-    size_t operator () (const aalta_formula& af) const
-    {
-      return af._hash;
-    }
-  };
-
   /* af指针的hash函数 */
   struct af_prt_hash
   {
@@ -136,11 +129,26 @@ private:
   //静态成员变量//
   //////////////////////////////////////////////////
 private:
-  static std::vector<std::string> names; // 存储操作符的名称以及原子变量的名称
+  /* 名称只追加且不移动, so get_name () reads them without the lock */
+  enum { NAME_CHUNK = 1024, NAME_CHUNKS = 4096 };
+  static std::string *names[NAME_CHUNKS]; // 分块存储操作符的名称以及原子变量的名称
+  static std::atomic<int> names_size; // 已发布的名称个数
   static hash_map<std::string, int> ids; // 名称和对应的位置映射
+  static std::mutex names_lock; // 保护ids和names的追加
   //static af_prt_map all_afs; // 所有aalta_formula实体和对应唯一指针的映射
-  static afp_set all_afs;
+
+  /* 唯一化表按hash分片, 每片一把锁, so threads only contend on the same shard */
+  enum { AF_SHARDS = 64 };
+  struct af_shard
+  {
+    std::mutex lock;
+    afp_set afs;
+    arena<aalta_formula> nodes; // afs中的公式, 由destroy ()一次性释放
+  };
+  static af_shard all_afs[AF_SHARDS];
   static tag_set all_tags; // 所有tag的集合
+  static arena<tag_t> tag_arena; // all_tags中的tag
+  static std::mutex tags_lock; // 保护all_tags和tag_arena
   static aalta_formula *_TRUE;
   static aalta_formula *_FALSE;
   //////////////////////////////////////////////////
@@ -205,18 +213,40 @@ public:
   aalta_formula *unique ();
   aalta_formula *simplify ();
   aalta_formula *classify (tag_t *tag = NULL);
+  aalta_formula *rename (const std::map<int, int>& atoms, hash_map<aalta_formula *, aalta_formula *, af_prt_hash>& done);
   size_t hash () {return _hash;}
+  int id () const {return _id;}
+  static int unique_count () {return _max_id;}   //unique formulas since the last destroy ()
+  static int live_count () {return _max_id - _reclaimed;}   //... not released by end_collection ()
   
-  static bool contain (af_prt_set, af_prt_set);
+  static bool contain (const af_prt_set&, const af_prt_set&);
 
 private:
 
   //added for af_prt_set identification, _id is set in unique ()
   int _id;
-  static int _max_id;
+  static std::atomic<int> _max_id;
   //
 
+  //results of flatted (), to_set () and get_alphabet (), computed on first use;
+  //the formulas are immutable once unique, so they never have to be recomputed
+  std::atomic<aalta_formula *> _flatted;
+  std::atomic<af_prt_set *> _set;
+  std::atomic<af_prt_set *> _alphabet;
+  const af_prt_set& cache_set (std::atomic<af_prt_set *>&, af_prt_set *);
+  void clear_cache ();
+
+  //the formulas marked by the running collection have _mark == _epoch
+  int _mark;
+  static int _epoch;
+  static int _first_collected;   //formulas with smaller ids are always kept
+  static std::atomic<int> _reclaimed;   //released since the last destroy ()
+  static std::vector<aalta_formula *> _gray;   //marked, operands not yet marked
+  static std::mutex collection_lock;   //held from begin_collection () to end_collection ()
+
   void init ();
+  static void init_names ();
+  static void add_name (const std::string& name);
   void clc_hash ();
 
   void build (const ltl_formula *formula, bool is_not = false, bool is_ltlf = false);
@@ -238,8 +268,16 @@ public:
   static aalta_formula *simplify_and (aalta_formula *l, aalta_formula *r);
   static aalta_formula *simplify_and_weak (aalta_formula *l, aalta_formula *r);
   static aalta_formula *merge_and (aalta_formula *af1, aalta_formula *af2);
-  static std::string get_name (int index);
+  static aalta_formula *merge (int op, const af_prt_set& afs);
+  static const std::string& get_name (int index);
+  static int atom_id (const std::string&);
   static void destroy ();
+  //releasing the unique formulas that are no longer used, see end_collection ()
+  static void begin_collection (int first);
+  static void mark (aalta_formula *);
+  static void mark (const af_prt_set&);
+  static bool marked (aalta_formula *af) {return af->_mark == _epoch;}
+  static int end_collection ();
   static aalta_formula *TRUE();
   static aalta_formula *FALSE();
   
@@ -251,8 +289,6 @@ public:
  *
  */
 public:
-  typedef hash_map<int, aalta_formula *> int_prt_map;
-  typedef hash_map<aalta_formula, int, af_hash> af_int_map;
   aalta_formula* off();        //obligation formula for LTLf formulas.
   aalta_formula* ofr();        //obligation formula for LTLf release formulas.
   aalta_formula* ofg();  //obligation formula for LTLf global formula
@@ -262,54 +298,51 @@ public:
   bool is_global();  //check whether the formula is a global one.
   bool is_wnext_free(); //check whether the formula is weak next free.
   
-  bool model(af_prt_set);       // check whether an assignment P models current formula 
+  bool model(const af_prt_set&);       // check whether an assignment P models current formula 
   bool model(aalta_formula*);   // handle when the assignment is a formula format 
-  aalta_formula* progf(af_prt_set);      //formula progression
+  aalta_formula* progf(const af_prt_set&);      //formula progression
   
   
   
 //private:
   /*only for boolean formulas*/
   
-  void toDIMACS(int_prt_map&, int (&cls)[MAX_CL][3], int&);    
-  void plus(int_prt_map&, af_int_map&, int&, int&, int, int (&cls)[MAX_CL][3], int&);
-  void minus(int_prt_map&, af_int_map&, int&, int&, int, int (&cls)[MAX_CL][3], int&);
-  
-  std::vector<std::vector<int> > toDIMACS(int_prt_map&);    
-  void plus(int_prt_map&, af_int_map&, int&, int&, int, std::vector<std::vector<int> >&);
-  void minus(int_prt_map&, af_int_map&, int&, int&, int, std::vector<std::vector<int> >&);
-  af_prt_set get_prop(std::string, int_prt_map);
+  //the CNF encoding is in sat_context
   af_prt_set SAT();  
   aalta_formula* erase_next_global (aalta_formula::af_prt_set&);
   af_prt_set SAT_core();
           
   bool find (aalta_formula*);          
   aalta_formula* mark_until ();    
-  bool model_until (af_prt_set);
   af_prt_set get_until_flags ();
   aalta_formula* normal ();
   bool is_until_marked ();
   aalta_formula* flatted ();
   static hash_map<aalta_formula*, aalta_formula *, af_prt_hash> _until_map;
   static hash_map<aalta_formula*, aalta_formula *, af_prt_hash> _var_until_map;
+  static std::mutex until_lock; // 保护_until_map和_var_until_map
   static void print_all_formulas ();
+  static afp_set all_formulas ();
   aalta_formula* get_var ();               //for Until formulas only
+  aalta_formula* find_var ();              //as get_var, but the variable must already exist
   aalta_formula* get_until ();             //for the variables representing until formulas only
   //aalta_formula* neg_prop(af_prt_set);   //create the formula for !{a, b, c, ...}
   /*only for boolean formulas*/
   
-  static int _sat_count;                // counting SAT invoking 
+  static std::atomic<int> _sat_count;   // counting SAT invoking, by all sessions
   static void print_sat_count ();
+  static std::atomic<long> _cache_hits;    // flatted (), to_set () and get_alphabet () answered from the cache
+  static std::atomic<long> _cache_misses;  // ... and computed
+  static void print_cache_count ();
   bool find_prop_atom (aalta_formula*);
   
    
   bool is_in(std::vector<aalta_formula*>);
-  int search(aalta_formula, af_int_map&, int&);
-  af_prt_set to_set(); //get the and elements in an And formula
+  const af_prt_set& to_set(); //get the and elements in an And formula
   void to_set (af_prt_set&); //another version
   
   hash_set<aalta_formula*> and_to_set();
-  af_prt_set get_alphabet();
+  const af_prt_set& get_alphabet();
   void complete (af_prt_set&);
   
   std::string ltlf2ltl(); //translate ltlf to ltl 
@@ -0,0 +1,287 @@
+/* 
+ * File:   dag_formula.cpp
+ */
+
+#include "dag_formula.h"
+#include "../util/utility.h"
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+using namespace std;
+
+static const char *op_names[] = {
+  "t", "f", "a", "!", "X", "F", "G", "&", "|", "->", "<->", "U", "R", "W"
+};
+
+static void
+dag_error (const char *msg)
+{
+  print_error (msg);
+  exit (1);
+}
+
+/**
+ * 操作数个数, 一元运算只有右操作数
+ */
+int
+dag_formula::arity (int op)
+{
+  return op <= Atom ? 0 : (op <= Globally ? 1 : 2);
+}
+
+/**
+ * 添加一个定义, 操作数必须是之前的定义
+ * An operand the operator does not take is -1.
+ */
+void
+dag_formula::add (int op, int left, int right, int atom)
+{
+  int n = _nodes.size ();
+  if (left >= n || right >= n)
+    dag_error ("dag: a definition refers to a later one");
+  if (left < -1 || right < -1)
+    dag_error ("dag: bad operand");
+  if ((arity (op) >= 1 && right < 0) || (arity (op) == 2 && left < 0))
+    dag_error ("dag: missing operand");
+  node nd;
+  nd.op = op, nd.left = left, nd.right = right, nd.atom = atom;
+  _nodes.push_back (nd);
+  _pos.push_back (NULL);
+  _neg.push_back (NULL);
+}
+
+/**
+ * 第index个定义(is_not时为其否定)对应的unique公式, 
+ * 与build (const ltl_formula *, bool)的转换相同, 左操作数先于右操作数
+ * @param index
+ * @param is_not
+ * @return 
+ */
+aalta_formula *
+dag_formula::build (int index, bool is_not)
+{
+  aalta_formula *&res = is_not ? _neg[index] : _pos[index];
+  if (res != NULL)
+    return res;
+  const node& nd = _nodes[index];
+  aalta_formula *l, *r;
+  switch (nd.op)
+    {
+    case True: // [! True = False]
+      res = is_not ? aalta_formula::FALSE () : aalta_formula::TRUE ();
+      break;
+    case False:
+      res = is_not ? aalta_formula::TRUE () : aalta_formula::FALSE ();
+      break;
+    case Atom:
+      res = aalta_formula (nd.atom, NULL, NULL).unique ();
+      if (is_not)
+        res = aalta_formula (aalta_formula::Not, NULL, res).unique ();
+      break;
+    case Not: // [!!a = a]
+      res = build (nd.right, !is_not);
+      break;
+    case Next: // [!(Xa) = X(!a)]
+      r = build (nd.right, is_not);
+      res = aalta_formula (aalta_formula::Next, NULL, r).unique ();
+      break;
+    case Future: // F a = True U a -- [!(F a) = False R !a]
+      r = build (nd.right, is_not);
+      if (is_not)
+        res = aalta_formula (aalta_formula::Release, aalta_formula::FALSE (), r).unique ();
+      else
+        res = aalta_formula (aalta_formula::Until, aalta_formula::TRUE (), r).unique ();
+      break;
+    case Globally: // G a = False R a -- [!(G a) = True U !a]
+      r = build (nd.right, is_not);
+      if (is_not)
+        res = aalta_formula (aalta_formula::Until, aalta_formula::TRUE (), r).unique ();
+      else
+        res = aalta_formula (aalta_formula::Release, aalta_formula::FALSE (), r).unique ();
+      break;
+    case And: // [!(a & b) = !a | !b]
+    case Or:
+    case Until: // [!(a U b) = !a R !b]
+    case Release:
+      {
+        l = build (nd.left, is_not);
+        r = build (nd.right, is_not);
+        int op;
+        if (nd.op == And) op = is_not ? aalta_formula::Or : aalta_formula::And;
+        else if (nd.op == Or) op = is_not ? aalta_formula::And : aalta_formula::Or;
+        else if (nd.op == Until) op = is_not ? aalta_formula::Release : aalta_formula::Until;
+        else op = is_not ? aalta_formula::Until : aalta_formula::Release;
+        res = aalta_formula (op, l, r).unique ();
+      }
+      break;
+    case Implies: // a->b = !a | b -- [!(a->b) = a & !b]
+      l = build (nd.left, !is_not);
+      r = build (nd.right, is_not);
+      res = aalta_formula (is_not ? aalta_formula::And : aalta_formula::Or, l, r).unique ();
+      break;
+    case Equiv: // a<->b = (!a | b)&(!b | a) -- [!(a<->b) = (a & !b)|(b & !a)]
+      {
+        int op = is_not ? aalta_formula::And : aalta_formula::Or;
+        l = build (nd.left, !is_not);
+        r = build (nd.right, is_not);
+        aalta_formula *l2 = aalta_formula (op, l, r).unique ();
+        l = build (nd.right, !is_not);
+        r = build (nd.left, is_not);
+        aalta_formula *r2 = aalta_formula (op, l, r).unique ();
+        res = aalta_formula (is_not ? aalta_formula::Or : aalta_formula::And, l2, r2).unique ();
+      }
+      break;
+    case WeakUntil: // a W b = b R (a | b) -- [!(a W b) = !b U (!a & !b)]
+      {
+        l = build (nd.right, is_not);
+        aalta_formula *a = build (nd.left, is_not);
+        aalta_formula *b = build (nd.right, is_not);
+        r = aalta_formula (is_not ? aalta_formula::And : aalta_formula::Or, a, b).unique ();
+        res = aalta_formula (is_not ? aalta_formula::Until : aalta_formula::Release, l, r).unique ();
+      }
+      break;
+    }
+  return res;
+}
+
+aalta_formula *
+dag_formula::root ()
+{
+  if (_nodes.empty ())
+    dag_error ("dag: no definitions");
+  return build (_nodes.size () - 1, false);
+}
+
+bool
+dag_formula::is_dag (const char *input)
+{
+  while (isspace (*input)) input++;
+  return strncmp (input, "dag", 3) == 0 && isspace (input[3]);
+}
+
+/**
+ * 文本格式: "dag" 后跟以';'分隔的定义
+ * @param input
+ * @return 
+ */
+aalta_formula *
+dag_formula::parse (const char *input)
+{
+  dag_formula dag;
+  const char *p = input;
+  int index = 0;   // 当前定义的编号
+  while (isspace (*p)) p++;
+  p += 3;
+  for (;; index++)
+    {
+      while (isspace (*p)) p++;
+      if (*p == '\0')
+        break;
+      const char *begin = p;
+      while (*p != '\0' && !isspace (*p) && *p != ';') p++;
+      string op (begin, p);
+      int kind = 0;
+      while (kind < Undefined && op != op_names[kind]) kind++;
+      if (kind == Undefined)
+        dag_error (("dag: unknown operator " + op).c_str ());
+      int args[2] = {-1, -1}, n = 0, atom = -1;
+      if (kind == Atom)
+        {
+          while (isspace (*p)) p++;
+          begin = p;
+          while (isalnum (*p) || *p == '_') p++;
+          if (p == begin)
+            dag_error ("dag: atom without name");
+          atom = aalta_formula::atom_id (string (begin, p));
+        }
+      else
+        {
+          for (; n < arity (kind); n++)
+            {
+              char *end;
+              long v = strtol (p, &end, 10);
+              if (end == p || v < 0)
+                dag_error ("dag: missing operand");
+              if (v >= index)
+                dag_error ("dag: a definition refers to a later one");
+              args[n] = v;
+              p = end;
+            }
+        }
+      if (n == 1)
+        dag.add (kind, -1, args[0], atom);
+      else
+        dag.add (kind, args[0], args[1], atom);
+      while (isspace (*p)) p++;
+      if (*p == ';')
+        p++;
+      else if (*p != '\0')
+        dag_error ("dag: expected ';'");
+    }
+  return dag.root ();
+}
+
+static bool
+read_uint (FILE *fp, int bytes, unsigned long& v)
+{
+  unsigned char buf[4];
+  if (fread (buf, 1, bytes, fp) != (size_t) bytes)
+    return false;
+  v = 0;
+  for (int i = bytes - 1; i >= 0; i--)
+    v = (v << 8) | buf[i];
+  return true;
+}
+
+/**
+ * 二进制格式, 见dag_formula.h
+ * @param fp
+ * @return 
+ */
+aalta_formula *
+dag_formula::read (FILE *fp)
+{
+  char magic[4];
+  size_t got = fread (magic, 1, 4, fp);
+  if (got == 0)
+    return NULL;
+  if (got != 4 || memcmp (magic, "DAG1", 4) != 0)
+    dag_error ("dag: bad binary record");
+  dag_formula dag;
+  unsigned long count, v;
+  if (!read_uint (fp, 4, count))
+    dag_error ("dag: truncated binary record");
+  for (unsigned long i = 0; i < count; i++)
+    {
+      unsigned long kind;
+      if (!read_uint (fp, 1, kind) || kind >= Undefined)
+        dag_error ("dag: bad binary record");
+      int args[2] = {-1, -1}, atom = -1;
+      if (kind == Atom)
+        {
+          if (!read_uint (fp, 2, v))
+            dag_error ("dag: truncated binary record");
+          string name (v, '\0');
+          if (v > 0 && fread (&name[0], 1, v, fp) != v)
+            dag_error ("dag: truncated binary record");
+          atom = aalta_formula::atom_id (name);
+        }
+      else
+        {
+          for (int n = 0; n < arity (kind); n++)
+            {
+              if (!read_uint (fp, 4, v))
+                dag_error ("dag: truncated binary record");
+              if (v >= i)
+                dag_error ("dag: a definition refers to a later one");
+              args[n] = v;
+            }
+          if (arity (kind) == 1)
+            args[1] = args[0], args[0] = -1;
+        }
+      dag.add (kind, args[0], args[1], atom);
+    }
+  return dag.root ();
+}
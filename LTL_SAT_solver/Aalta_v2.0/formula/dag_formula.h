@@ -0,0 +1,59 @@
+/* 
+ * File:   dag_formula.h
+ * 
+ * Input format that keeps the sharing of subformulas. A formula is a
+ * list of numbered definitions, each referring to earlier ones by
+ * number; the last one is the formula:
+ *   dag a p; a q; & 0 1; G 2; W 3 0
+ * is (G (p & q)) W p. The definitions are
+ *   t, f, a <name>, ! i, X i, F i, G i,
+ *   & i j, | i j, -> i j, <-> i j, U i j, R i j, W i j (weak until).
+ * The binary variant is a sequence of records: "DAG1", the number of
+ * definitions (uint32), then per definition the operator code (uint8,
+ * in the order above) and its operands (uint32 numbers; an atom is a
+ * uint16 length and the name); all integers little endian.
+ * The definitions are turned into unique aalta_formula nodes directly,
+ * in the same form aalta_formula (const char *) builds.
+ */
+
+#ifndef DAG_FORMULA_H
+#define	DAG_FORMULA_H
+
+#include "aalta_formula.h"
+
+#include <stdio.h>
+#include <vector>
+
+class dag_formula
+{
+private:
+  enum opkind
+  {
+    True, False, Atom, Not, Next, Future, Globally,
+    And, Or, Implies, Equiv, Until, Release, WeakUntil, Undefined
+  };
+  struct node
+  {
+    int op;
+    int left, right; // 操作数的编号
+    int atom; // 原子变量的id
+  };
+  std::vector<node> _nodes;
+  std::vector<aalta_formula *> _pos; // 各定义对应的公式
+  std::vector<aalta_formula *> _neg; // 及其否定
+
+  static int arity (int op);
+  void add (int op, int left, int right, int atom);
+  aalta_formula *build (int index, bool is_not);
+  aalta_formula *root ();
+
+public:
+  /* input以"dag"开头 */
+  static bool is_dag (const char *input);
+  /* 文本格式 */
+  static aalta_formula *parse (const char *input);
+  /* 二进制格式, 读取一条记录; 输入结束时返回NULL */
+  static aalta_formula *read (FILE *fp);
+};
+
+#endif	/* DAG_FORMULA_H */
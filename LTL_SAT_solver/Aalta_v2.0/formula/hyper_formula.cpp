@@ -0,0 +1,142 @@
+/* 
+ * File:   hyper_formula.cpp
+ */
+
+#include "hyper_formula.h"
+#include "dag_formula.h"
+#include "../util/utility.h"
+#include <ctype.h>
+#include <map>
+#include <stdlib.h>
+
+using namespace std;
+
+/**
+ * 读取一个量词 "exists x." 或 "forall x.", 成功时input移到'.'之后
+ * @param input
+ * @param quantifier
+ * @param var
+ * @return 
+ */
+bool
+hyper_formula::read_quantifier (const char *&input, std::string& quantifier, std::string& var)
+{
+  const char *p = input;
+  while (isspace (*p)) p++;
+  const char *begin = p;
+  while (isalpha (*p)) p++;
+  quantifier = string (begin, p);
+  if (quantifier != "exists" && quantifier != "forall")
+    return false;
+  if (!isspace (*p))
+    return false;
+  while (isspace (*p)) p++;
+  begin = p;
+  while (isalnum (*p) || *p == '_') p++;
+  var = string (begin, p);
+  if (var.empty ())
+    return false;
+  while (isspace (*p)) p++;
+  if (*p != '.')
+    return false;
+  input = p + 1;
+  return true;
+}
+
+bool
+hyper_formula::is_hyper (const char *input)
+{
+  string quantifier, var;
+  return read_quantifier (input, quantifier, var);
+}
+
+hyper_formula::hyper_formula (const char *input)
+{
+  string quantifier, var;
+  while (read_quantifier (input, quantifier, var))
+    {
+      if (quantifier == "forall")
+        _forall.push_back (var);
+      else if (_forall.empty ())
+        _exists.push_back (var);
+      else
+        {
+          print_error ("only exists*forall* HyperLTL formulas are supported");
+          exit (1);
+        }
+    }
+  if (dag_formula::is_dag (input))
+    _body = dag_formula::parse (input);
+  else
+    _body = aalta_formula (input).unique ();
+}
+
+// without existential traces all universal traces can be the same one
+vector<string>
+hyper_formula::traces () const
+{
+  if (_exists.empty ())
+    return vector<string> (1, _forall.front ());
+  return _exists;
+}
+
+aalta_formula *
+hyper_formula::expand ()
+{
+  vector<string> exists = traces ();
+
+  // the atoms a_y of the body with y universal: id, "a_" and the index of y;
+  // the trace of an atom is the longest quantified one it ends in
+  vector<string> quantified = _forall;
+  quantified.insert (quantified.end (), _exists.begin (), _exists.end ());
+  vector<int> ids, traces;
+  vector<string> props;
+  vector<aalta_formula *> stack (1, _body);
+  aalta_formula::af_prt_set seen;
+  while (!stack.empty ())
+    {
+      aalta_formula *f = stack.back ();
+      stack.pop_back ();
+      if (f == NULL || !seen.insert (f).second)
+        continue;
+      if (f->oper () > aalta_formula::Undefined)
+        {
+          const string& name = aalta_formula::get_name (f->oper ());
+          int i = trace_of (name, quantified);
+          if (i >= 0 && i < _forall.size ())
+            {
+              ids.push_back (f->oper ());
+              props.push_back (name.substr (0, name.size () - _forall[i].size ()));
+              traces.push_back (i);
+            }
+          continue;
+        }
+      stack.push_back (f->l_af ());
+      stack.push_back (f->r_af ());
+    }
+
+  // one copy per assignment, in the order of eahyper's every_selection:
+  // lexicographic with the existential traces taken from last to first
+  vector<aalta_formula *> copies;
+  vector<int> sel (_forall.size (), exists.size () - 1);
+  while (true)
+    {
+      map<int, int> atoms;
+      for (int i = 0; i < ids.size (); i++)
+        atoms[ids[i]] = aalta_formula::atom_id (props[i] + exists[sel[traces[i]]]);
+      hash_map<aalta_formula *, aalta_formula *, aalta_formula::af_prt_hash> done;
+      copies.push_back (_body->rename (atoms, done));
+
+      int i = sel.size () - 1;
+      while (i >= 0 && sel[i] == 0)
+        sel[i--] = exists.size () - 1;
+      if (i < 0)
+        break;
+      sel[i]--;
+    }
+
+  aalta_formula *res = copies.back ();
+  for (int i = copies.size () - 2; i >= 0; i--)
+    res = aalta_formula (aalta_formula::And, copies[i], res).unique ();
+  return res;
+}
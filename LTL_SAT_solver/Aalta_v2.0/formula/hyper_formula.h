@@ -0,0 +1,42 @@
+/* 
+ * File:   hyper_formula.h
+ * 
+ * ∃*∀* HyperLTL input of the form
+ *   exists x1. ... exists xk. forall y1. ... forall yn. body
+ * where the body is LTL (or a DAG, see dag_formula.h) over the atoms a_x (proposition a on trace x;
+ * a and x may contain '_', x is the longest quantified variable that fits), as eahyper prints them.
+ * The equisatisfiable LTL formula is the conjunction of the body over
+ * all k^n assignments of existential to universal trace variables.
+ * The copies are built by renaming atoms on the unique body, so they
+ * share every subformula that does not mention a universal trace.
+ */
+
+#ifndef HYPER_FORMULA_H
+#define	HYPER_FORMULA_H
+
+#include "aalta_formula.h"
+
+#include <string>
+#include <vector>
+
+class hyper_formula
+{
+private:
+  std::vector<std::string> _exists; // 存在量词的trace变量
+  std::vector<std::string> _forall; // 全称量词的trace变量
+  aalta_formula *_body; // unique
+
+  static bool read_quantifier (const char *&input, std::string& quantifier, std::string& var);
+
+public:
+  hyper_formula (const char *input);
+
+  /* input以量词前缀开头 */
+  static bool is_hyper (const char *input);
+  /* 展开后的LTL公式(unique) */
+  aalta_formula *expand ();
+  /* 展开后的公式中的trace变量 */
+  std::vector<std::string> traces () const;
+};
+
+#endif	/* HYPER_FORMULA_H */
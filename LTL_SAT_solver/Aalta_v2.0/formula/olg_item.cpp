@@ -9,10 +9,9 @@
 #include "olg_item.h"
 #include "../util/define.h"
 #include "../util/utility.h"
+#include "../util/statistics.h"
 #include <iostream>
 #include <assert.h>
-#include <zlib.h>
-#include "core/Dimacs.h"
 #include "core/Solver.h"
 #include "core/SolverTypes.h"
 
@@ -364,8 +363,8 @@ olg_atom::to_string () const
 
 /*added by Jianwen Li on April 29, 2014
    * creat the Dimacs format for Minisat 
-   * the output is stored in the file "cnf.dimacs"
-   * Invoked by toDimacs() of olg_formula
+   * the clauses are added to the solver S directly, no file is involved
+   * Invoked by SATCall()
    */
 int olg_item::_varNum = 0; //the var number in cnf
 int olg_item::_clNum = 0;  // the clause number in cnf
@@ -374,65 +373,57 @@ hash_map<int, int> olg_item::_vMap;//the mapping between variable ids and encodi
 std::vector<olg_item*> olg_item::_items;
 std::vector<olg_atom*> olg_item::_atoms;
 
+//add the Dimacs clause (a b c) to S, 0 ends the clause
+static void
+add_dimacs_clause (Minisat::Solver& S, int a, int b = 0, int c = 0)
+{
+  int cl[] = {a, b, c};
+  vec<Lit> lits;
+  for (int i = 0; i < 3 && cl[i] != 0; i ++)
+    lits.push (cl[i] > 0 ? mkLit (cl[i]-1) : ~mkLit (-cl[i]-1));
+  S.addClause_ (lits);
+}
+
 void
-olg_item::toDimacs()
+olg_item::toDimacs(Minisat::Solver& S)
 { 
-  FILE *f = NULL;
-  f = fopen("cnf.dimacs", "w");
   _varNum = _vMap.size();
   _clNum = 0;
   
-  if(f == NULL)
-  {
-    perror("cnf.dimacs");
-    exit(0);
-  }
   switch(_op)
   {
     case aalta_formula::And:
-    {
-      toDimacsPlus(NULL); 
-      _clNum ++;
-      fprintf(f, "p cnf %d %d\n", _varNum, _clNum);
-      fprintf(f, "%d 0\n", _id);
-      
-      toDimacsPlus(f);
-      break;
-    }
     case aalta_formula::Or:
     {
-      toDimacsPlus(NULL);
+      toDimacsPlus(NULL); 
       _clNum ++;
-      fprintf(f, "p cnf %d %d\n", _varNum, _clNum);
-      fprintf(f, "%d 0\n", _id);
+      while (S.nVars() < _varNum) S.newVar();
+      add_dimacs_clause(S, _id);
       
-      toDimacsPlus(f);
+      toDimacsPlus(&S);
       break;
     }
     case aalta_formula::Not: //why Not here?
     {
-      fprintf(f, "p cnf 1 1\n");
-      fprintf(f, "%d 0\n", -_vMap[_atom->_id]);
+      S.newVar();
+      add_dimacs_clause(S, -_vMap[_atom->_id]);
       break;
     }
     case aalta_formula::Literal:
     {
-      fprintf(f, "p cnf 1 1\n");
-      fprintf(f, "%d 0\n", _vMap[_atom->_id]);
+      S.newVar();
+      add_dimacs_clause(S, _vMap[_atom->_id]);
       break;
     }
     default:
       printf("To Dimacs error! Unrecognized operators...\n");
       exit(0);
   }
-  
-  fclose(f);
- 
 }
 
-//invoked by toDimacs();
+//invoked by toDimacs(); with S == NULL only counts the variables and clauses
 void 
-olg_item::toDimacsPlus(FILE *f) 
+olg_item::toDimacsPlus(Minisat::Solver *S) 
 {
   int lid, rid;
   if(_op == aalta_formula::And || _op == aalta_formula::Or)
@@ -466,33 +457,34 @@ olg_item::toDimacsPlus(FILE *f)
   {
     case aalta_formula::And:
     {
-      if(f != NULL)
+      if(S != NULL)
       {
-        fprintf(f, "%d %d 0\n%d %d 0\n", -_id, lid, -_id, rid);
+        add_dimacs_clause(*S, -_id, lid);
+        add_dimacs_clause(*S, -_id, rid);
       }
       else
       {
         _varNum ++;
         _clNum += 2;
       }
-      _left->toDimacsPlus(f);
-      _right->toDimacsPlus(f);
+      _left->toDimacsPlus(S);
+      _right->toDimacsPlus(S);
       
       break;
     }
     case aalta_formula::Or:
     {
-      if(f != NULL)
+      if(S != NULL)
       {
-        fprintf(f, "%d %d %d 0\n", -_id, lid, rid);
+        add_dimacs_clause(*S, -_id, lid, rid);
       }
       else
       {
         _varNum ++;
         _clNum ++;
       }
-      _left->toDimacsPlus(f);
-      _right->toDimacsPlus(f);
+      _left->toDimacsPlus(S);
+      _right->toDimacsPlus(S);
       break;
     }
     case aalta_formula::Not: //why Not here?
@@ -567,16 +559,11 @@ olg_item::SATCall ()
   getVars(i);
   int max = _vMap.size() + 1;
   setId(max);
-  toDimacs();
-  gzFile in = gzopen("cnf.dimacs", "rb");
-  if (in == NULL)
-  {
-    printf("Minisat ERROR: Could not open input file cn.dimacs!\n");
-    exit(1);
-  }
   Minisat::Solver S;
-  Minisat::parse_DIMACS(in, S);
-  gzclose(in);
+  toDimacs(S);
+  statistics::sat_calls[statistics::OLG] ++;
+  statistics::cnf_vars += S.nVars();
+  statistics::cnf_clauses += S.nClauses();
   if (!S.simplify())
   {
     return false;
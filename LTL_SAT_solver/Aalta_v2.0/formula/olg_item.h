@@ -16,6 +16,11 @@
 #include <stdlib.h>
 #include <vector>
 
+namespace Minisat
+{
+  class Solver;
+}
+
 struct olg_atom
 { // olg原子节点类型
 
@@ -74,10 +79,10 @@ struct olg_item
   
   /*added by Jianwen Li on April 29, 2014
    * creat the Dimacs format for Minisat from _root
-   *
+   * and add the clauses to the solver
    */
-  void toDimacs();
-  void toDimacsPlus(FILE*); // Invoked by toDimacs();
+  void toDimacs(Minisat::Solver&);
+  void toDimacsPlus(Minisat::Solver*); // Invoked by toDimacs();
   void setId(int&); //set the _id for Dimacs construction
   void getVars(int &); //set _vars
   void initial(); // reset the static variables
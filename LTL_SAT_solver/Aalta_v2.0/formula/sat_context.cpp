@@ -0,0 +1,453 @@
+/*
+ * File:   sat_context.cpp
+ */
+
+#include "sat_context.h"
+
+#include "checking/solver_session.h"
+#include "util/hash_set.h"
+#include "util/statistics.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace Minisat;
+
+sat_context::session_data::session_data ()
+{
+  _solver = NULL;
+  _true_var = -1;
+}
+
+sat_context::session_data::~session_data ()
+{
+  if (_solver != NULL)
+    delete _solver;
+}
+
+/**
+ * 丢掉未标记公式的编码和答案, 并标记留下的答案中的文字
+ * The clauses stay in the solver: they only constrain the variables of
+ * the dropped formulas, which are not assumed any more. A formula that
+ * is built again later gets new variables.
+ */
+void
+sat_context::session_data::forget_unmarked ()
+{
+  af_var_map *maps[] = {&_pos_vars, &_neg_vars, &_atom_vars};
+  for (int i = 0; i < 3; i ++)
+  {
+    for (af_var_map::iterator it = maps[i]->begin (); it != maps[i]->end (); )
+    {
+      if (aalta_formula::marked (it->first))
+        it ++;
+      else
+      {
+        if (maps[i] == &_atom_vars)
+          _var_atoms[it->second] = NULL;
+        it = maps[i]->erase (it);
+      }
+    }
+  }
+  for (af_query_map::iterator it = _queries.begin (); it != _queries.end (); )
+  {
+    if (aalta_formula::marked (it->first))
+      it ++;
+    else
+      it = _queries.erase (it);
+  }
+  hash_map<aalta_formula *, aalta_formula::af_prt_set, aalta_formula::af_prt_hash>::iterator it;
+  for (it = _results.begin (); it != _results.end (); )
+  {
+    if (aalta_formula::marked (it->first))
+    {
+      aalta_formula::mark (it->second);
+      it ++;
+    }
+    else
+      it = _results.erase (it);
+  }
+}
+
+sat_context::session_data&
+sat_context::session ()
+{
+  return *solver_session::current ()._sat;
+}
+
+/**
+ * 丢弃当前的solver及所有编码, 下一次solve时重新建立
+ * Must be called whenever the formulas it refers to are released.
+ * Only the context of the current session is dropped.
+ */
+void
+sat_context::reset ()
+{
+  if (session ()._solver != NULL)
+    delete session ()._solver;
+  session ()._solver = NULL;
+  session ()._pos_vars.clear ();
+  session ()._neg_vars.clear ();
+  session ()._atom_vars.clear ();
+  session ()._queries.clear ();
+  session ()._var_atoms.clear ();
+  session ()._true_var = -1;
+  session ()._results.clear ();
+}
+
+Minisat::Solver&
+sat_context::solver ()
+{
+  if (session ()._solver == NULL)
+  {
+    session ()._solver = new Minisat::Solver ();
+    session ()._true_var = new_var ();
+    session ()._solver->addClause (mkLit (session ()._true_var));
+    statistics::cnf_clauses ++;
+  }
+  return *session ()._solver;
+}
+
+/**
+ * 新变量默认不参与决策, 只有在被查询公式的锥内时才参与,
+ * so a query never branches on the variables of unrelated formulas.
+ */
+int
+sat_context::new_var (aalta_formula *atom)
+{
+  session ()._var_atoms.push_back (atom);
+  statistics::cnf_vars ++;
+  return session ()._solver->newVar (true, false);
+}
+
+int
+sat_context::atom_var (aalta_formula *af)
+{
+  af_var_map::iterator it = session ()._atom_vars.find (af);
+  if (it != session ()._atom_vars.end ())
+    return it->second;
+  int v = new_var (af);
+  session ()._atom_vars[af] = v;
+  return v;
+}
+
+/**
+ * 去掉af外层的Not; 若af是原子, True/False或已编码的And/Or, 返回true并把其文字写入l
+ */
+bool
+sat_context::known_literal (aalta_formula *&af, bool& positive, Minisat::Lit& l)
+{
+  while (af->oper () == aalta_formula::Not)
+  {
+    if (af->r_af ()->oper () == aalta_formula::Not)
+    {
+      printf ("Error: two Not together in sat_context::encode\n");
+      exit (0);
+    }
+    af = af->r_af ()->unique ();
+    positive = !positive;
+  }
+  switch (af->oper ())
+  {
+    case aalta_formula::True:
+      l = positive ? mkLit (session ()._true_var) : ~mkLit (session ()._true_var);
+      return true;
+    case aalta_formula::False:
+      l = positive ? ~mkLit (session ()._true_var) : mkLit (session ()._true_var);
+      return true;
+    case aalta_formula::And:
+    case aalta_formula::Or:
+    {
+      af_var_map& vars = positive ? session ()._pos_vars : session ()._neg_vars;
+      af_var_map::iterator it = vars.find (af);
+      if (it == vars.end ())
+        return false;
+      l = mkLit (it->second);
+      return true;
+    }
+    default:
+      l = positive ? mkLit (atom_var (af)) : ~mkLit (atom_var (af));
+      return true;
+  }
+}
+
+/**
+ * 返回一个文字l, 满足 l -> af (positive) 或 l -> !af (!positive)
+ * The clauses are added once for each (formula, polarity) pair and are
+ * kept for all later queries. The formula is walked on an explicit
+ * stack (left operand, right operand, then the node itself), so deep
+ * formulas such as long conjunctions do not overflow the call stack.
+ */
+Minisat::Lit
+sat_context::encode (aalta_formula *af, bool positive)
+{
+  struct frame
+  {
+    aalta_formula *af;
+    bool positive;
+    int stage;   // 0: new, 1: left operand done, 2: both operands done
+  };
+  std::vector<frame> stack;
+  std::vector<Lit> done;   // the literals of the finished operands
+  frame top = {af, positive, 0};
+  stack.push_back (top);
+  while (!stack.empty ())
+  {
+    frame& fr = stack.back ();
+    if (fr.stage == 0)
+    {
+      Lit l;
+      if (known_literal (fr.af, fr.positive, l))
+      {
+        done.push_back (l);
+        stack.pop_back ();
+        continue;
+      }
+      fr.stage = 1;
+      frame left = {fr.af->l_af ()->unique (), fr.positive, 0};
+      stack.push_back (left);
+    }
+    else if (fr.stage == 1)
+    {
+      fr.stage = 2;
+      frame right = {fr.af->r_af ()->unique (), fr.positive, 0};
+      stack.push_back (right);
+    }
+    else
+    {
+      Lit r = done.back ();
+      done.pop_back ();
+      Lit l = done.back ();
+      done.pop_back ();
+      int v = new_var ();
+      (fr.positive ? session ()._pos_vars : session ()._neg_vars)[fr.af] = v;
+      // v -> (l & r) for a positive And or a negative Or, v -> (l | r) otherwise
+      if ((fr.af->oper () == aalta_formula::And) == fr.positive)
+      {
+        session ()._solver->addClause (~mkLit (v), l);
+        session ()._solver->addClause (~mkLit (v), r);
+        statistics::cnf_clauses += 2;
+      }
+      else
+      {
+        session ()._solver->addClause (~mkLit (v), l, r);
+        statistics::cnf_clauses ++;
+      }
+      done.push_back (mkLit (v));
+      stack.pop_back ();
+    }
+  }
+  return done.back ();
+}
+
+/**
+ * 收集af(正极性)的锥中的变量: 原子变量和定义变量
+ * The atoms come first, the first `atoms' entries of the result.
+ */
+sat_context::query_t&
+sat_context::query (aalta_formula *af)
+{
+  af_query_map::iterator it = session ()._queries.find (af);
+  if (it != session ()._queries.end ())
+    return it->second;
+  query_t& res = session ()._queries[af];
+  std::vector<int> defs;
+  aalta_formula::af_prt_set visited[2];
+  std::vector<std::pair<aalta_formula *, bool> > stack;
+  stack.push_back (std::make_pair (af, true));
+  while (!stack.empty ())
+  {
+    aalta_formula *f = stack.back ().first;
+    bool positive = stack.back ().second;
+    stack.pop_back ();
+    if (!visited[positive].insert (f).second)
+      continue;
+    switch (f->oper ())
+    {
+      case aalta_formula::True:
+      case aalta_formula::False:
+        break;
+      case aalta_formula::Not:
+        stack.push_back (std::make_pair (f->r_af ()->unique (), !positive));
+        break;
+      case aalta_formula::And:
+      case aalta_formula::Or:
+      {
+        af_var_map& vars = positive ? session ()._pos_vars : session ()._neg_vars;
+        af_var_map::iterator vit = vars.find (f);
+        if (vit == vars.end ())
+        {
+          printf ("Error: query of a formula that is not encoded in sat_context::query\n");
+          exit (1);
+        }
+        defs.push_back (vit->second);
+        stack.push_back (std::make_pair (f->l_af ()->unique (), positive));
+        stack.push_back (std::make_pair (f->r_af ()->unique (), positive));
+        break;
+      }
+      default:
+        if (visited[!positive].find (f) == visited[!positive].end ())
+          res.vars.push_back (atom_var (f));
+        break;
+    }
+  }
+  res.atoms = res.vars.size ();
+  res.vars.insert (res.vars.end (), defs.begin (), defs.end ());
+  return res;
+}
+
+/**
+ * 判断布尔公式af的可满足性
+ * The answers are kept for the session, so a formula asked again (the
+ * same unique node, e.g. the same state and _avoid in get_next_pair or
+ * the same candidate in a core computation) is not solved again.
+ * @return 可满足时返回模型中af的原子及其取反, 否则返回空集
+ */
+aalta_formula::af_prt_set
+sat_context::solve (aalta_formula *af)
+{
+  af = af->unique ();
+  hash_map<aalta_formula *, aalta_formula::af_prt_set, aalta_formula::af_prt_hash>::iterator it;
+  it = session ()._results.find (af);
+  if (it != session ()._results.end ())
+  {
+    statistics::sat_memo_hits ++;
+    return it->second;
+  }
+  statistics::sat_memo_misses ++;
+  aalta_formula::af_prt_set& P = session ()._results[af];
+  Solver& S = solver ();
+  Lit act = encode (af, true);
+  query_t& q = query (af);
+  if (!S.okay ())
+    return P;
+
+  std::vector<aalta_formula *> fs (1, af);
+  set_decision (fs, true);
+  vec<Lit> assumps;
+  assumps.push (act);
+  bool sat = solve_under (assumps);
+  set_decision (fs, false);
+  if (!sat)
+    return P;
+
+  for (int i = 0; i < q.atoms; i ++)
+  {
+    if (S.model[q.vars[i]] == l_True)
+      P.insert (session ()._var_atoms[q.vars[i]]);
+    else
+      P.insert (aalta_formula (aalta_formula::Not, NULL, session ()._var_atoms[q.vars[i]]).unique ());
+  }
+  return P;
+}
+
+/**
+ * 打开/关闭fs中所有公式的锥中变量的决策.
+ * Only these cones are decided during a call; their saved phases are
+ * dropped so that the atoms prefer false as they do in a fresh solver.
+ */
+void
+sat_context::set_decision (const std::vector<aalta_formula *>& fs, bool b)
+{
+  for (int i = 0; i < fs.size (); i ++)
+  {
+    query_t& q = query (fs[i]);
+    for (int j = 0; j < q.vars.size (); j ++)
+    {
+      if (b)
+        session ()._solver->setPolarity (q.vars[j], true);
+      session ()._solver->setDecisionVar (q.vars[j], b);
+    }
+  }
+}
+
+bool
+sat_context::solve_under (vec<Lit>& assumps)
+{
+  aalta_formula::_sat_count ++;
+  statistics::sat_call ();
+  return session ()._solver->solveLimited (assumps) == l_True;
+}
+
+/**
+ * 计算 fixed /\ cands[0] /\ ... /\ cands[n-1] 的极小不可满足核.
+ * Every candidate is selected by its defining literal as an assumption.
+ * The first core is read off the final conflict of the solver; it is
+ * then minimised by dropping one candidate at a time, and every unsat
+ * answer shrinks the remaining candidates to the new final conflict
+ * (clause-set refinement), so a core costs far fewer SAT calls than
+ * candidates.
+ * @param fixed 始终保留的部分, 可以为NULL
+ * @param core 返回核中候选公式在cands中的下标 (按cands中的顺序)
+ * @return false if the conjunction is satisfiable, true otherwise
+ */
+bool
+sat_context::unsat_core (aalta_formula *fixed, const std::vector<aalta_formula *>& cands, std::vector<int>& core)
+{
+  core.clear ();
+  Solver& S = solver ();
+  std::vector<aalta_formula *> fs;
+  std::vector<Lit> lits;
+  for (int i = 0; i < cands.size (); i ++)
+  {
+    fs.push_back (cands[i]->unique ());
+    lits.push_back (encode (fs.back (), true));
+  }
+  Lit base = mkLit (session ()._true_var);
+  if (fixed != NULL)
+  {
+    fs.push_back (fixed->unique ());
+    base = encode (fs.back (), true);
+  }
+  if (!S.okay ())
+    return true;
+
+  set_decision (fs, true);
+  vec<Lit> assumps;
+  assumps.push (base);
+  for (int i = 0; i < lits.size (); i ++)
+    assumps.push (lits[i]);
+  bool sat = solve_under (assumps);
+
+  std::vector<int> cur;
+  hash_set<int> conflict;
+  if (!sat)
+  {
+    for (int i = 0; i < S.conflict.size (); i ++)
+      conflict.insert (toInt (S.conflict[i]));
+    for (int i = 0; i < lits.size (); i ++)
+      if (conflict.find (toInt (~lits[i])) != conflict.end ())
+        cur.push_back (i);
+  }
+
+  //candidates before pos are known to be necessary
+  int pos = 0;
+  while (!sat && pos < cur.size ())
+  {
+    assumps.clear ();
+    assumps.push (base);
+    for (int i = 0; i < cur.size (); i ++)
+      if (i != pos)
+        assumps.push (lits[cur[i]]);
+    statistics::muc_iterations ++;
+    if (solve_under (assumps))
+    {
+      pos ++;
+      continue;
+    }
+    conflict.clear ();
+    for (int i = 0; i < S.conflict.size (); i ++)
+      conflict.insert (toInt (S.conflict[i]));
+    std::vector<int> next;
+    for (int i = 0; i < cur.size (); i ++)
+      if (i != pos && conflict.find (toInt (~lits[cur[i]])) != conflict.end ())
+        next.push_back (cur[i]);
+    cur = next;
+  }
+  set_decision (fs, false);
+
+  if (sat)
+    return false;
+  core = cur;
+  return true;
+}
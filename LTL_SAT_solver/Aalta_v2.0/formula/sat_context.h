@@ -0,0 +1,65 @@
+/*
+ * Incremental SAT context shared by all aalta_formula::SAT () calls
+ * of one checking run. Every (sub)formula gets a defining variable v
+ * with the one-directional clauses v -> f (resp. v -> !f), which stay
+ * in a single long-lived Minisat instance; a query on f is then solved
+ * under the assumption v, so the encoding and the learnt clauses are
+ * reused by all later queries sharing structure with f. The context
+ * lives in the current solver_session.
+ *
+ * File:   sat_context.h
+ */
+
+#ifndef SAT_CONTEXT_H
+#define SAT_CONTEXT_H
+
+#include "aalta_formula.h"
+#include "core/Solver.h"
+
+#include <vector>
+
+class sat_context
+{
+public:
+  static aalta_formula::af_prt_set solve (aalta_formula *);
+  static bool unsat_core (aalta_formula *, const std::vector<aalta_formula *>&, std::vector<int>&);
+  static void reset ();
+
+  typedef hash_map<aalta_formula *, int, aalta_formula::af_prt_hash> af_var_map;
+  struct query_t
+  {
+    std::vector<int> vars; // the variables in the cone of the formula
+    int atoms;             // vars[0 .. atoms-1] are the atoms
+  };
+  typedef hash_map<aalta_formula *, query_t, aalta_formula::af_prt_hash> af_query_map;
+
+  // the solver and the encodings of one solver_session
+  struct session_data
+  {
+    session_data ();
+    ~session_data ();
+    // called by a collection after the formulas in use are marked
+    void forget_unmarked ();
+    Minisat::Solver *_solver;
+    af_var_map _pos_vars;     // v -> f
+    af_var_map _neg_vars;     // v -> !f
+    af_var_map _atom_vars;    // atoms (literals, X, U, R ...) and their variables
+    af_query_map _queries;    // the cone of each queried formula
+    std::vector<aalta_formula *> _var_atoms; // variable -> atom, NULL for defining variables
+    int _true_var;
+    hash_map<aalta_formula *, aalta_formula::af_prt_set, aalta_formula::af_prt_hash> _results; // answers of solve ()
+  };
+
+private:
+  static session_data& session ();
+  static Minisat::Solver& solver ();
+  static int new_var (aalta_formula *atom = NULL);
+  static Minisat::Lit encode (aalta_formula *, bool);
+  static bool known_literal (aalta_formula *&, bool&, Minisat::Lit&);
+  static int atom_var (aalta_formula *);
+  static query_t& query (aalta_formula *);
+  static void set_decision (const std::vector<aalta_formula *>&, bool);
+  static bool solve_under (Minisat::vec<Minisat::Lit>&);
+};
+
+#endif
@@ -1,12 +1,102 @@
 #include "sat_solver.h"
 #include "buchi/buchi_automata.h"
 #include "checking/nondeter_checker.h"
+#include "checking/solver_session.h"
+#include "checking/portfolio.h"
+#include "checking/result_cache.h"
+#include "checking/decomposition.h"
+#include "formula/hyper_formula.h"
+#include "formula/dag_formula.h"
 #include "util/utility.h"
+#include "util/statistics.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/time.h>
 #define MAXN 100000000
 char in[MAXN];
+bool use_portfolio = false;   //--portfolio: race all engines
+result_cache *cache = NULL;   //--cache=<file>: answers of earlier runs
+const char *stats_file = NULL;   //--stats=<file>: write the statistics as JSON
+
+/**
+ * the unique formula of the input line, which is either LTL, a DAG
+ * (see formula/dag_formula.h) or exists*forall* HyperLTL (see
+ * formula/hyper_formula.h)
+ */
+aalta_formula*
+parse_formula (const char *input)
+{
+  if (hyper_formula::is_hyper (input))
+  {
+    hyper_formula hf (input);
+    nondeter_checker::set_trace_names (hf.traces ());
+    return hf.expand ();
+  }
+  nondeter_checker::set_trace_names (std::vector<std::string> ());
+  if (dag_formula::is_dag (input))
+    return dag_formula::parse (input);
+  return aalta_formula(input).unique();
+}
+
+double
+current_time ()
+{
+  struct timeval tv;
+  gettimeofday (&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+/**
+ * check af with the nondeterministic checker, part by part if it is a
+ * conjunction of atom-disjoint parts, or with the portfolio of all
+ * engines; returns "sat", "unsat" or "unknown". With --cache the
+ * answer is looked up first and stored after a search.
+ */
+const char*
+check_formula (aalta_formula *af)
+{
+  std::string key;
+  if (cache != NULL)
+  {
+    key = result_cache::fingerprint (af);
+    const char *res = key.empty () ? NULL : cache->lookup (key);
+    if (res != NULL)
+    {
+      statistics::result_cache_hits ++;
+      return res;
+    }
+    statistics::result_cache_misses ++;
+  }
+  double start = current_time ();
+  const char *res;
+  if (use_portfolio)
+    res = portfolio (af).check ();
+  else
+    res = decomposition (af).check ();
+  if (cache != NULL && !key.empty () && strcmp (res, "unknown") != 0)
+    cache->store (key, res, current_time () - start);
+  return res;
+}
+
+/**
+ * simplify and check af, whose parsing started at start; the phase
+ * times are added to the statistics
+ */
+const char*
+answer (aalta_formula *af, double start)
+{
+  double parsed = current_time ();
+  af = af->simplify ();
+  double simplified = current_time ();
+  const char *res = check_formula (af);
+  statistics::queries ++;
+  statistics::parse_time += parsed - start;
+  statistics::simplify_time += simplified - parsed;
+  statistics::check_time += current_time () - simplified;
+  statistics::formula_nodes += aalta_formula::unique_count ();
+  return res;
+}
 
 
 void 
@@ -27,16 +117,56 @@ nondeter_sat (int argc, char** argv)
     }
   aalta_formula* af;
   
-  af = aalta_formula(in).unique();
-  af = af->simplify ();
-  
-  nondeter_checker ch (af);
+  double start = current_time ();
+  af = parse_formula (in);
   
-  printf ("%s\n", ch.check () ? "sat" : "unsat");
+  printf ("%s\n", answer (af, start));
   //aalta_formula::print_sat_count ();
   aalta_formula::destroy();
 }
 
+/**
+ * Batch mode: read one formula per line from stdin until EOF and answer
+ * each with "sat" or "unsat" followed by the checking time in seconds.
+ * With binary, stdin is a sequence of binary DAG records instead.
+ * The session and the formulas are released after every query, so
+ * each answer is the same as that of a separate aalta run; the search
+ * heuristics depend on the formula ids. A query that hits the memory
+ * limit is answered with "unknown".
+ */
+void
+nondeter_batch (bool binary)
+{
+  aalta_formula* af;
+  double start;
+  solver_session session;
+  session.activate ();
+  while (true)
+    {
+      if (binary)
+        {
+          start = current_time ();
+          af = dag_formula::read (stdin);
+          if (af == NULL)
+            break;
+        }
+      else
+        {
+          if (fgets (in, MAXN, stdin) == NULL)
+            break;
+          if (strspn (in, " \t\r\n") == strlen (in))
+            continue;
+          start = current_time ();
+          af = parse_formula (in);
+        }
+      const char *res = answer (af, start);
+      aalta_formula::destroy();
+      session.reset ();
+      printf ("%s %.6f\n", res, current_time () - start);
+      fflush (stdout);
+    }
+}
+
 /*
 void 
 deter_sat (int argc, char** argv)
@@ -173,12 +303,38 @@ buchi (int argc, char** argv)
 }
 
 
-double
-current_time ()
+std::vector<std::string>
+split_traces (const char *list)
 {
-  struct timeval tv;
-  gettimeofday (&tv, NULL);
-  return tv.tv_sec + tv.tv_usec / 1000000.0;
+  std::vector<std::string> res;
+  std::string trace;
+  for (const char *p = list; ; p++)
+  {
+    if (*p == ',' || *p == '\0')
+    {
+      if (!trace.empty ())
+        res.push_back (trace);
+      trace.clear ();
+      if (*p == '\0')
+        break;
+    }
+    else
+      trace += *p;
+  }
+  return res;
+}
+
+void
+write_stats (const char *path)
+{
+  FILE *fp = fopen (path, "w");
+  if (fp == NULL)
+  {
+    print_error ((std::string ("cannot write the statistics to ") + path).c_str ());
+    exit (1);
+  }
+  statistics::write (fp);
+  fclose (fp);
 }
 
 void print_help()
@@ -188,6 +344,19 @@ void print_help()
   printf("\n\t\t-l -c (-e)\t\tLTL satisfiability checking (default). An evidence is shown if '-e' is given and the formula is satisfiable.;\n");
   printf("\n\t\t-f -c (-e)\t\tLTLf satisfiability checking. An evidence is given if '-e' is given and the formula is satisfiable.;\n");
   printf("\n\t\t-l -b\t\tLTL-to-Buchi translation.\n");
+  printf("\n\t\t--batch\t\tLTL satisfiability checking of one formula per line of the input.\n");
+  printf("\n\t\t\t\tAn input of the form 'exists x. forall y. body' is exists*forall* HyperLTL, where the atom a_x is a on trace x.\n");
+  printf("\n\t\t\t\tAn input starting with 'dag' is a list of definitions that keeps shared subformulas, see formula/dag_formula.h.\n");
+  printf("\n\t\t--binary\t\tLike --batch, but the input is a sequence of binary DAG records.\n");
+  printf("\n\t\t--portfolio\t\tRun all satisfiability engines in parallel processes and take the first answer.\n");
+  printf("\n\t\t--symmetry=<x,y,...>\t\tTreat the traces x, y, ... (atoms a_x, a_y, ...) as interchangeable; by default they are found from the atom names.\n");
+  printf("\n\t\t--no-symmetry\t\tDo not identify states that are equal up to exchanging traces.\n");
+  printf("\n\t\t--no-decompose\t\tCheck a conjunction of atom-disjoint parts as a whole instead of each part in its own process.\n");
+  printf("\n\t\t--cache=<file>\t\tKeep the answers in <file>, shared by all aalta processes, and reuse them for formulas equal up to renaming the atoms.\n");
+  printf("\n\t\t--stats=<file>\t\tWrite the counters and phase times of the run to <file> as JSON.\n");
+  printf("\n\t\t--memory-limit=<MB>\t\tGive up with 'unknown' when the process grows beyond <MB> megabytes.\n");
+  printf("\n\t\t--gc=<n>\t\tRelease the formulas the search no longer uses whenever it has created <n> new ones (at least as many as it kept the last time) and no other solver session is alive; default 0, never.\n");
+  printf("\n\t\t--successor-cache=<n>\t\tKeep the successors found for the last <n> search states and reuse them when a state is expanded again (default 0, off).\n");
   printf("\n\t\t-h\t\t Help information\n");
   printf("\n\t\twhere every parameter has the meaning of:\n");
   printf("\t\t-l\t\tThe input is an LTL formula;\n");
@@ -299,7 +468,48 @@ main (int argc, char** argv)
   //sat (argc, argv);
   //ltlf_sat(argc, argv);
   //buchi (argc, argv);
-  nondeter_sat (argc, argv);
+  bool batch = false;
+  bool binary = false;
+  int i = 1;
+  for (; i < argc && strncmp (argv[i], "--", 2) == 0; i++)
+  {
+    if (strcmp (argv[i], "--batch") == 0)
+      batch = true;
+    else if (strcmp (argv[i], "--binary") == 0)
+      binary = true;
+    else if (strcmp (argv[i], "--portfolio") == 0)
+      use_portfolio = true;
+    else if (strcmp (argv[i], "--no-symmetry") == 0)
+      nondeter_checker::use_symmetry (false);
+    else if (strncmp (argv[i], "--symmetry=", 11) == 0)
+      nondeter_checker::set_symmetric_traces (split_traces (argv[i] + 11));
+    else if (strcmp (argv[i], "--no-decompose") == 0)
+      decomposition::enable (false);
+    else if (strncmp (argv[i], "--cache=", 8) == 0)
+      cache = new result_cache (argv[i] + 8);
+    else if (strncmp (argv[i], "--stats=", 8) == 0)
+      stats_file = argv[i] + 8;
+    else if (strncmp (argv[i], "--memory-limit=", 15) == 0)
+      nondeter_checker::set_memory_limit (atol (argv[i] + 15));
+    else if (strncmp (argv[i], "--gc=", 5) == 0)
+      nondeter_checker::set_gc_threshold (atol (argv[i] + 5));
+    else if (strncmp (argv[i], "--successor-cache=", 18) == 0)
+      nondeter_prog_state::set_successor_cache (atol (argv[i] + 18));
+    else
+    {
+      print_help ();
+      return 0;
+    }
+  }
+  if (batch || binary)
+    nondeter_batch (binary);
+  else
+  {
+    argv[i-1] = argv[0];
+    nondeter_sat (argc - i + 1, argv + i - 1);
+  }
+  if (stats_file != NULL)
+    write_stats (stats_file);
   return 0;
   
 
@@ -0,0 +1,79 @@
+/*
+ * File:   core_store.cpp
+ */
+
+ #include "core_store.h"
+ #include "util/statistics.h"
+
+ uint64_t
+ core_store::signature (const aalta_formula::af_prt_set& P)
+ {
+   uint64_t res = 0;
+   for (aalta_formula::af_prt_set::const_iterator it = P.begin (); it != P.end (); it ++)
+     res |= (uint64_t) 1 << ((*it)->id () % 64);
+   return res;
+ }
+
+ //whether the conjuncts of e are all in P, whose signature is sig
+ bool
+ core_store::subset (const entry& e, uint64_t sig, const aalta_formula::af_prt_set& P)
+ {
+   if ((e.signature & ~sig) != 0)
+     return false;
+   const aalta_formula::af_prt_set& C = e.af->to_set ();
+   for (aalta_formula::af_prt_set::const_iterator it = C.begin (); it != C.end (); it ++)
+   {
+     if (P.find (*it) == P.end ())
+       return false;
+   }
+   return true;
+ }
+
+ bool
+ core_store::add (aalta_formula *f)
+ {
+   const aalta_formula::af_prt_set& P = f->to_set ();
+   uint64_t sig = signature (P);
+   for (int i = 0; i < _cores.size (); i ++)
+   {
+     if (subset (_cores[i], sig, P))
+       return false;
+   }
+   entry e;
+   e.af = f;
+   e.signature = sig;
+   int j = 0;
+   for (int i = 0; i < _cores.size (); i ++)
+   {
+     if (!subset (e, _cores[i].signature, _cores[i].af->to_set ()))
+       _cores[j ++] = _cores[i];
+   }
+   statistics::cores_dropped += _cores.size () - j;
+   _cores.resize (j);
+   _cores.push_back (e);
+   return true;
+ }
+
+ bool
+ core_store::contains_core (aalta_formula *f) const
+ {
+   if (_cores.empty ())
+     return false;
+   const aalta_formula::af_prt_set& P = f->to_set ();
+   uint64_t sig = signature (P);
+   for (int i = 0; i < _cores.size (); i ++)
+   {
+     if (subset (_cores[i], sig, P))
+       return true;
+   }
+   return false;
+ }
+
+ std::vector<aalta_formula*>
+ core_store::cores () const
+ {
+   std::vector<aalta_formula*> res;
+   for (int i = 0; i < _cores.size (); i ++)
+     res.push_back (_cores[i].af);
+   return res;
+ }
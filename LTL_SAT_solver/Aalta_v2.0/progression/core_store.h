@@ -0,0 +1,47 @@
+/*
+ * The unsat cores learned by the nondeterministic progression
+ *
+ * File:   core_store.h
+ *
+ * A core is a conjunction whose conjuncts no satisfiable state contains
+ * all together; nondeter_prog_state learns them while searching and
+ * forbids them in the next states through _avoid. The store answers
+ * whether a state contains one of the cores without asking the SAT
+ * solver: every core keeps a 64-bit signature of its conjunct ids, and
+ * only the cores whose signature is covered by the state's are compared
+ * conjunct by conjunct. A core that contains another one is redundant
+ * and is dropped.
+ */
+
+#ifndef CORE_STORE_H
+#define CORE_STORE_H
+
+#include "formula/aalta_formula.h"
+#include <stdint.h>
+#include <vector>
+
+class core_store
+{
+  public:
+    //false if a stored core is contained in f (f is not stored then);
+    //otherwise f is stored and the stored cores containing f are dropped
+    bool add (aalta_formula *f);
+    //true if the conjuncts of f include all conjuncts of a stored core
+    bool contains_core (aalta_formula *f) const;
+    //the stored cores in the order they were added
+    std::vector<aalta_formula*> cores () const;
+    int size () const { return _cores.size (); }
+
+  private:
+    struct entry
+    {
+      aalta_formula *af;
+      uint64_t signature;
+    };
+    std::vector<entry> _cores;
+
+    static uint64_t signature (const aalta_formula::af_prt_set&);
+    static bool subset (const entry&, uint64_t, const aalta_formula::af_prt_set&);
+};
+
+#endif
@@ -10,6 +10,9 @@
  
  #include "nondeter_prog_state.h"
  #include "checking/checker.h"
+ #include "formula/sat_context.h"
+ #include "checking/solver_session.h"
+ #include "util/statistics.h"
  #include <iostream>
  #include <assert.h>
  #include <stdio.h>
@@ -17,36 +20,20 @@
  
  using namespace std;
  
- aalta_formula::af_prt_set nondeter_prog_state::_unsatisfied;
- aalta_formula::af_prt_set nondeter_prog_state::_unsatisfied_untils;
-
- aalta_formula* nondeter_prog_state::_avoid = NULL;
-
- 
- bool nondeter_prog_state::_global_not_set = true;
- aalta_formula::af_prt_set nondeter_prog_state::_globals;
-  //for implementation reason, _invariant_found is used to flag the current constraint is an invariant so as to be 
-  //considered to be unsat
- bool nondeter_prog_state::_invariant_found = false;
- aalta_formula* nondeter_prog_state::_next_wanted = NULL;
- //for implementation reason, _fulfilled is used to flag _unsatisfied is indeed eliminated
- //rather than is originally empty
- bool nondeter_prog_state::_fulfilled = false;
- 
  void 
  nondeter_prog_state::set_unsatisfied_untils ()
  {
-   _unsatisfied_untils.clear ();
-   for (aalta_formula::af_prt_set::iterator it = _unsatisfied.begin (); it != _unsatisfied.end (); it ++)
+   session ()._unsatisfied_untils.clear ();
+   for (aalta_formula::af_prt_set::iterator it = session ()._unsatisfied.begin (); it != session ()._unsatisfied.end (); it ++)
    {
-     _unsatisfied_untils.insert ((*it)->get_until ());
+     session ()._unsatisfied_untils.insert ((*it)->get_until ());
    }
  }
  
  void 
  nondeter_prog_state::initial_unsatisfied (aalta_formula *f)
  {
-    _unsatisfied = get_until_element_of (f);
+    session ()._unsatisfied = get_until_element_of (f);
     set_unsatisfied_untils ();
  }
  
@@ -58,11 +45,12 @@
    _constraints = NULL;
    //add_constraint ();
    _assignments = NULL;
+   _resume = 0;
    //_all_progfs.push_back (this);
-   if (_global_not_set)
+   if (session ()._global_not_set)
    {
      set_global ();
-     _global_not_set = false;
+     session ()._global_not_set = false;
    }
    
    //must after set_global ()
@@ -73,19 +61,19 @@
  void 
  nondeter_prog_state::set_avoid ()
  {
-   if (_avoid == NULL)
+   if (session ()._avoid == NULL)
    {
      aalta_formula::af_prt_set P = _formula->get_alphabet ();
      //checker::print (P);
-     _avoid = avoid_next_false (P);
+     session ()._avoid = avoid_next_false (P);
          
      aalta_formula *global = global_next_true ();
      if (global != NULL)
-       _avoid = aalta_formula (aalta_formula::And, _avoid, global).unique ();
+       session ()._avoid = aalta_formula (aalta_formula::And, session ()._avoid, global).unique ();
        
      global = global_next_n_true ();
      if (global != NULL)
-       _avoid = aalta_formula (aalta_formula::And, _avoid, global).unique ();
+       session ()._avoid = aalta_formula (aalta_formula::And, session ()._avoid, global).unique ();
      
      //printf ("%s\n", _avoid->to_string ().c_str ());
    }
@@ -161,10 +149,10 @@
  aalta_formula* 
  nondeter_prog_state::prop_in_globals ()
  {
-   if (_globals.empty ())
+   if (session ()._globals.empty ())
      return NULL;
    aalta_formula *res = NULL;
-   for (aalta_formula::af_prt_set::iterator it = _globals.begin (); it != _globals.end (); it ++)
+   for (aalta_formula::af_prt_set::iterator it = session ()._globals.begin (); it != session ()._globals.end (); it ++)
    {
      if (is_prop ((*it)->r_af ()))
      {
@@ -313,21 +301,21 @@
  aalta_formula* 
  nondeter_prog_state::global_next_true ()
  {
-   if (_globals.empty ())
+   if (session ()._globals.empty ())
      return NULL;
-   aalta_formula::af_prt_set::iterator it = _globals.begin ();
+   aalta_formula::af_prt_set::iterator it = session ()._globals.begin ();
    aalta_formula *res, *f;
    while (!is_prop ((*it)->r_af()))
    {
      it ++;
-     if (it == _globals.end ())
+     if (it == session ()._globals.end ())
        return NULL;
    }
    f = next_must_true (*it);
    assert (f != NULL);
    res = f;
    it ++;
-   for (; it != _globals.end (); it ++)
+   for (; it != session ()._globals.end (); it ++)
    {
      if (!is_prop ((*it)->r_af ()))
        continue;
@@ -365,11 +353,11 @@
 
  
  aalta_formula* 
- nondeter_prog_state::avoid_next_false (aalta_formula::af_prt_set P)
+ nondeter_prog_state::avoid_next_false (const aalta_formula::af_prt_set& P)
  {
    aalta_formula *nx, *not_nx, *res1, *res2, *res;
    res = NULL;
-   for (aalta_formula::af_prt_set::iterator it = P.begin (); it != P.end (); it ++)
+   for (aalta_formula::af_prt_set::const_iterator it = P.begin (); it != P.end (); it ++)
    {
      nx = aalta_formula (aalta_formula::Next, NULL, *it).unique ();
      not_nx = 
@@ -416,13 +404,13 @@
    aalta_formula::af_prt_set P = get_until_element_of (_formula);
    aalta_formula *temp;
    aalta_formula::af_prt_set P2;
-   P2.insert (_unsatisfied.begin (), _unsatisfied.end ());
+   P2.insert (session ()._unsatisfied.begin (), session ()._unsatisfied.end ());
    for (aalta_formula::af_prt_set::iterator it = P2.begin (); it != P2.end (); it ++)
    {
      //printf ("nondeter_prog_state::update_unsatisfied: %s\n", (*it)->to_string ().c_str ());
      if (P.find (*it) == P.end ())
      {
-       _unsatisfied.erase (*it);
+       session ()._unsatisfied.erase (*it);
      }
    }
    set_unsatisfied_untils ();
@@ -432,21 +420,16 @@
  
  
  
- aalta_formula::af_prt_set nondeter_prog_state::_potential_unsat;
- aalta_formula* nondeter_prog_state::_unsat_root = NULL;
- std::vector<std::pair<aalta_formula::af_prt_set, aalta_formula*> > nondeter_prog_state::_witness;
- hash_map<aalta_formula*, node*, aalta_formula::af_prt_hash> nondeter_prog_state::_f_node_map;
- bool nondeter_prog_state::_fill_witness_already_done = false;
  
  void 
- nondeter_prog_state::update_node (aalta_formula *f, aalta_formula *ucore, aalta_formula::af_prt_set P, aalta_formula *nx)
+ nondeter_prog_state::update_node (aalta_formula *f, aalta_formula *ucore, const aalta_formula::af_prt_set& P, aalta_formula *nx)
  {
    //printf ("update_node:: create transition:\n%s\n->\n%s\n", nx->to_string().c_str (), f->to_string().c_str ());
-   hash_map<aalta_formula*, node*, aalta_formula::af_prt_hash>::iterator it = _f_node_map.find (f);
+   hash_map<aalta_formula*, node*, aalta_formula::af_prt_hash>::iterator it = session ()._f_node_map.find (f);
    aalta_formula::af_prt_set S;
    S.clear ();
    std::pair<aalta_formula::af_prt_set, aalta_formula*> pa;
-   if (it != _f_node_map.end ())
+   if (it != session ()._f_node_map.end ())
    {
      node *n = it->second;
      pa = n->_tran;
@@ -455,21 +438,21 @@
        n2 = new node (f, n->_ucore, pa);
      else
        n2 = new node (f, ucore, pa);
-     _f_node_map.erase (it);
-     _f_node_map.insert (pair<aalta_formula*, node*> (f, n2));
+     session ()._f_node_map.erase (it);
+     session ()._f_node_map.insert (pair<aalta_formula*, node*> (f, n2));
      delete n;
    }
    else
    {
      pa = make_pair (S, (aalta_formula*)NULL);
      node *n = new node (f, ucore, pa);
-     _f_node_map.insert (pair<aalta_formula*, node*> (f, n));
+     session ()._f_node_map.insert (pair<aalta_formula*, node*> (f, n));
    }
    
    if (nx == NULL)
      return;
-   it = _f_node_map.find (nx);
-   if (it != _f_node_map.end ())
+   it = session ()._f_node_map.find (nx);
+   if (it != session ()._f_node_map.end ())
    {
      printf ("nondeter_prog::update_node:\n The formula already creates the node!\n%s\n", nx->to_string().c_str());
      //print_f_node_map ();
@@ -480,34 +463,34 @@
      std::vector<std::pair<aalta_formula::af_prt_set, aalta_formula*> > trans;
      std::pair<aalta_formula::af_prt_set, aalta_formula*> tran = make_pair (P, f);
      node *n = new node (nx, NULL, tran);
-     _f_node_map.insert (pair<aalta_formula*, node*> (nx, n));
+     session ()._f_node_map.insert (pair<aalta_formula*, node*> (nx, n));
    }
    
  }
  
  void 
- nondeter_prog_state::add_transition_to_node (aalta_formula* f, aalta_formula::af_prt_set P, aalta_formula* nx)
+ nondeter_prog_state::add_transition_to_node (aalta_formula* f, const aalta_formula::af_prt_set& P, aalta_formula* nx)
  {
-   hash_map<aalta_formula*, node*, aalta_formula::af_prt_hash>::iterator it = _f_node_map.find (nx);
-   if (it == _f_node_map.end ())
+   hash_map<aalta_formula*, node*, aalta_formula::af_prt_hash>::iterator it = session ()._f_node_map.find (nx);
+   if (it == session ()._f_node_map.end ())
    {
      printf ("nondeter_prog_state::add_transition_to_node:\n The formula already creates the node: \n%s\n", nx->to_string().c_str());
      exit (0);
    }
    std::pair<aalta_formula::af_prt_set, aalta_formula*> tran = make_pair (P, f);
    node *n = new node (nx, NULL, tran);
-   _f_node_map.insert (pair<aalta_formula*, node*> (nx, n));
+   session ()._f_node_map.insert (pair<aalta_formula*, node*> (nx, n));
  }
  
  void 
  nondeter_prog_state::clear_f_node_map ()
  {
    hash_map<aalta_formula*, node*, aalta_formula::af_prt_hash>::iterator it;
-   for (it = _f_node_map.begin (); it != _f_node_map.end (); it ++)
+   for (it = session ()._f_node_map.begin (); it != session ()._f_node_map.end (); it ++)
    {
      delete it->second;
    }
-   _f_node_map.clear ();
+   session ()._f_node_map.clear ();
  }
  
  //print elements in _f_node_map
@@ -516,7 +499,7 @@
  {
    hash_map<aalta_formula*, node*, aalta_formula::af_prt_hash>::iterator it;
    aalta_formula *f;
-   for (it = _f_node_map.begin (); it != _f_node_map.end (); it ++)
+   for (it = session ()._f_node_map.begin (); it != session ()._f_node_map.end (); it ++)
    {
      f = (it->second->_tran).second;
      /*
@@ -533,8 +516,8 @@
  nondeter_prog_state::fill_witness_from_to (aalta_formula *dest)
  {
    //assert (_unsat_root != dest);
-   hash_map<aalta_formula*, node*, aalta_formula::af_prt_hash>::iterator it = _f_node_map.find (dest);
-   if (it == _f_node_map.end ())
+   hash_map<aalta_formula*, node*, aalta_formula::af_prt_hash>::iterator it = session ()._f_node_map.find (dest);
+   if (it == session ()._f_node_map.end ())
    {
      printf ("nondeter_prog_state::fill_witness_from_to:\n Cannot find the node:\n%s\n", dest->to_string().c_str ());
      exit (0);
@@ -542,16 +525,16 @@
    node *n = it->second;
    if ((n->_tran).second == NULL)
    {
-     printf ("nondeter_prog_state::fill_witness_from_to:\nCannot find the path to:\n%s\n", _unsat_root->to_string().c_str());
+     printf ("nondeter_prog_state::fill_witness_from_to:\nCannot find the path to:\n%s\n", session ()._unsat_root->to_string().c_str());
      print_f_node_map ();
-     aalta_formula::af_prt_set P = _unsat_root->to_set ();
+     aalta_formula::af_prt_set P = session ()._unsat_root->to_set ();
      //checker::print (P);
      exit (0);
    }
    else
    {
-     _witness.push_back (pair<aalta_formula::af_prt_set, aalta_formula*> ((n->_tran).first, dest));
-     if ((n->_tran).second == _unsat_root)
+     session ()._witness.push_back (pair<aalta_formula::af_prt_set, aalta_formula*> ((n->_tran).first, dest));
+     if ((n->_tran).second == session ()._unsat_root)
        return;
      else
        fill_witness_from_to ((n->_tran).second);
@@ -560,35 +543,24 @@
  }
  
  aalta_formula* 
- nondeter_prog_state::AND (aalta_formula::af_prt_set P)
+ nondeter_prog_state::AND (const aalta_formula::af_prt_set& P)
  {
    return convert_to_formula (P);
  }
  
  aalta_formula* 
- nondeter_prog_state::OR (aalta_formula::af_prt_set P)
+ nondeter_prog_state::OR (const aalta_formula::af_prt_set& P)
  {
-   aalta_formula *res = NULL;
-   if (P.empty ())
-     return res;
-   aalta_formula::af_prt_set::iterator it = P.begin ();
-   res = *it;
-   it ++;
-   for (; it != P.end (); it ++)
-   {
-     res = aalta_formula (aalta_formula::Or, res, *it).unique ();
-   }
-   return res;
+   return aalta_formula::merge (aalta_formula::Or, P);
  } 
  
- nondeter_prog_state::history_map nondeter_prog_state::_hist_map;
  
  std::pair<aalta_formula::af_prt_set, bool>  
- nondeter_prog_state::match_from_history (aalta_formula *f, aalta_formula::af_prt_set P)
+ nondeter_prog_state::match_from_history (aalta_formula *f, const aalta_formula::af_prt_set& P)
  {
    aalta_formula::af_prt_set res;
-   history_map::iterator it = _hist_map.find (f);
-   if (it == _hist_map.end ())
+   history_map::iterator it = session ()._hist_map.find (f);
+   if (it == session ()._hist_map.end ())
      return std::make_pair (res, false);
    std::vector<aalta_formula::af_prt_set > vec = it->second;
    aalta_formula::af_prt_set P1;
@@ -601,152 +573,75 @@
  }
  
  void 
- nondeter_prog_state::update_history (aalta_formula* ucore, aalta_formula::af_prt_set P)
+ nondeter_prog_state::update_history (aalta_formula* ucore, const aalta_formula::af_prt_set& P)
  {
    aalta_formula::af_prt_set res;
-   history_map::iterator it = _hist_map.find (ucore);
+   history_map::iterator it = session ()._hist_map.find (ucore);
    std::vector<aalta_formula::af_prt_set > vec;
-   if (it == _hist_map.end ())
+   if (it == session ()._hist_map.end ())
    {
      vec.push_back (P);
-     _hist_map.insert (pair<aalta_formula*, std::vector<aalta_formula::af_prt_set > > (ucore, vec));
+     session ()._hist_map.insert (pair<aalta_formula*, std::vector<aalta_formula::af_prt_set > > (ucore, vec));
    }
    else
    {
      vec = it->second;
      vec.push_back (P);
-     _hist_map.erase (ucore);
-     _hist_map.insert (pair<aalta_formula*, std::vector<aalta_formula::af_prt_set > > (ucore, vec));
+     session ()._hist_map.erase (ucore);
+     session ()._hist_map.insert (pair<aalta_formula*, std::vector<aalta_formula::af_prt_set > > (ucore, vec));
    }
    return;
  }
  
- //split binary the formula set P into two sets P2 and P3
- void 
- nondeter_prog_state::split_binary (aalta_formula::af_prt_set P, aalta_formula::af_prt_set& P2,         
-                                    aalta_formula::af_prt_set& P3)
- {
-   int binary = P.size () / 2;
-   int i = 0;
-   for (aalta_formula::af_prt_set::iterator it = P.begin (); it != P.end (); it ++)
-   {
-     if (i < binary)
-       P2.insert (*it);
-     else
-       P3.insert (*it);
-     i ++;
-   }
- }
- 
- aalta_formula* 
- nondeter_prog_state::create_list_formula (std::list <aalta_formula::af_prt_set > lt)
+ //compute the minimal subset core of cands such that flatted (AND (core)) /\ fixed is unsat,
+ //return false if flatted (AND (cands)) /\ fixed is satisfiable
+ bool 
+ nondeter_prog_state::unsat_core (const aalta_formula::af_prt_set& cands, aalta_formula *fixed, 
+                                  aalta_formula::af_prt_set& core)
  {
-   aalta_formula *res = NULL;
-   for (std::list <aalta_formula::af_prt_set > ::iterator it = lt.begin (); it != lt.end (); it ++)
+   std::vector<aalta_formula*> elems, flats;
+   for (aalta_formula::af_prt_set::const_iterator it = cands.begin (); it != cands.end (); it ++)
    {
-     if (res == NULL)
-       res = AND (*it);
-     else
-       res = aalta_formula (aalta_formula::And, res, AND (*it)).unique ();
+     //!(X a) is ignored by convert_to_formula
+     if ((*it)->oper () == aalta_formula::Not && (*it)->r_af ()->oper () == aalta_formula::Next)
+       continue;
+     elems.push_back (*it);
+     flats.push_back ((*it)->flatted ());
    }
-   return res;
+   std::vector<int> index;
+   if (!sat_context::unsat_core (fixed, flats, index))
+     return false;
+   for (int i = 0; i < index.size (); i ++)
+     core.insert (elems[index[i]]);
+   return true;
  }
  
  //compute the minimal unsat core from f corresponding to ! X (avoid)
  aalta_formula* 
- nondeter_prog_state::MUC (aalta_formula::af_prt_set f_set, aalta_formula *avoid)
+ nondeter_prog_state::MUC (const aalta_formula::af_prt_set& f_set, aalta_formula *avoid)
  {
+   statistics::scope stats_site (statistics::MUC);
    //printf ("in MUC, the set is\n");
    //checker::print (f_set);
-   aalta_formula* guarantee_check = create_check_formula (AND (f_set), avoid);
-   aalta_formula::af_prt_set P = guarantee_check->SAT();
-   if (!P.empty ())
-   {
-     printf ("MUC: the formula is satisfiable\n%s\n%s\n%s\n", (AND (f_set)->to_string()).c_str (), avoid->to_string().c_str (), guarantee_check->to_string ().c_str ());
-     //checker::print (P);
-     //printf ("MUC::_unsatisfied is\n");
-     //checker::print (_unsatisfied);
-     exit (0);
-   }
-   
    aalta_formula* basic_to_check = create_check_formula (NULL, avoid);
-   P = basic_to_check->SAT ();
+   aalta_formula::af_prt_set P = basic_to_check->SAT ();
    if (P.empty ())
    {
      return NULL;
    }
    
-   P = f_set;
-   std::list <aalta_formula::af_prt_set > lt;
-   lt.push_back (P);
-   aalta_formula::af_prt_set P2, P3, P4, affirmed;
-   aalta_formula *f2, *f3, *f_affirmed, *lt_formula;
-   while (!lt.empty ())
-   {
-     P = lt.front ();
-     lt.pop_front ();
-     f_affirmed = AND (affirmed);
-     lt_formula = create_list_formula (lt);
-     
-     P2.clear ();
-     P3.clear ();
-     split_binary (P, P2, P3);
-     if (P2.size () == 1 && P3.empty ())
-     {
-       affirmed.insert (P2.begin (), P2.end ());
-       continue;
-     }
-     else if (!P2.empty ())
-     {
-       f2 = AND (P2);
-       if (f_affirmed != NULL)
-         f2 = aalta_formula (aalta_formula::And, f2, f_affirmed).unique ();
-       if (lt_formula != NULL)
-         f2 = aalta_formula (aalta_formula::And, f2, lt_formula).unique ();
-       f2 = f2->flatted ();
-       if (basic_to_check != NULL)
-         f2 = aalta_formula (aalta_formula::And, f2, basic_to_check).unique ();
-       P4 = f2->SAT ();
-       if (P4.empty ())
-       {
-         lt.push_back (P2);
-         continue;
-       }
-     }
-     
-     if (P3.size () == 1 && P2.empty ())
-     {
-       affirmed.insert (P3.begin (), P3.end ());
-       continue;
-     }
-     else if (!P3.empty ())
-     {
-       f3 = AND (P3);
-       if (f_affirmed != NULL)
-         f3 = aalta_formula (aalta_formula::And, f3, f_affirmed).unique ();
-       if (lt_formula != NULL)
-         f3 = aalta_formula (aalta_formula::And, f3, lt_formula).unique ();
-       f3 = f3->flatted ();
-       if (basic_to_check != NULL)
-         f3 = aalta_formula (aalta_formula::And, f3, basic_to_check).unique ();
-       P4 = f3->SAT ();
-       if (P4.empty ())
-       {
-         lt.push_back (P3);
-         continue;
-       }
-     }
-     
-     if (!P2.empty ())
-       lt.push_back (P2);
-     if (!P3.empty ())
-       lt.push_back (P3);
+   aalta_formula::af_prt_set affirmed;
+   if (!unsat_core (f_set, basic_to_check, affirmed))
+   {
+     aalta_formula* guarantee_check = create_check_formula (AND (f_set), avoid);
+     printf ("MUC: the formula is satisfiable\n%s\n%s\n%s\n", (AND (f_set)->to_string()).c_str (), avoid->to_string().c_str (), guarantee_check->to_string ().c_str ());
+     exit (0);
    }
    
    if (avoid != NULL)
    {
-     for (aalta_formula::af_prt_set::iterator it = _unsatisfied_untils.begin (); 
-         it != _unsatisfied_untils.end (); it ++)
+     for (aalta_formula::af_prt_set::iterator it = session ()._unsatisfied_untils.begin (); 
+         it != session ()._unsatisfied_untils.end (); it ++)
          affirmed.erase (*it);
    }
      
@@ -756,70 +651,46 @@
  aalta_formula* 
  nondeter_prog_state::MUC (aalta_formula *f, aalta_formula *ucore)
  {
+   statistics::scope stats_site (statistics::MUC);
    
    //assert (ucore != NULL);
    aalta_formula::af_prt_set P, P2, P3, P4, P5;
-   int count  = 0;
    P = f->to_set ();
-   if (ucore == NULL)
-   {
-     P3.insert (P.begin (), P.end ());
-   }
-   else
-   {
+   if (ucore != NULL)
      P2 = ucore->to_set ();
-     for (aalta_formula::af_prt_set::iterator it = P.begin (); it != P.end (); it ++)
-     {
-       if (P2.find (*it) == P2.end () && _globals.find (*it) == _globals.end ())
-         P3.insert (*it);
-     }
+   //the globals and the elements of ucore are always kept
+   for (aalta_formula::af_prt_set::iterator it = P.begin (); it != P.end (); it ++)
+   {
+     if (P2.find (*it) == P2.end () && session ()._globals.find (*it) == session ()._globals.end ())
+       P3.insert (*it);
+     else
+       P4.insert (*it);
    }
    
-   //std::pair<aalta_formula::af_prt_set, bool> pa = match_from_history (ucore, P3);
-   //if (pa.second)
-     //P = pa.first;
-   //else
-   {   
-   P2.clear ();
-   P2.insert (P.begin (), P.end ());
-   P5.insert (P.begin (), P.end ());
-   P4.clear ();
-   P.clear ();
-   aalta_formula *f2, *f3, *f4, *nx;
+   aalta_formula *f2, *f3, *nx;
    nx = NULL;
-   if (_avoid != NULL)
-     nx = _avoid;
-   f3 = OR (_potential_unsat);
+   if (session ()._avoid != NULL)
+     nx = session ()._avoid;
+   f3 = OR (session ()._potential_unsat);
    if (f3 != NULL)
      nx = aalta_formula (aalta_formula::And, nx, negation_next(f3)).unique ();
    if (ucore != NULL)
      nx = aalta_formula (aalta_formula::And, nx, negation_next(ucore)).unique ();
    
-   for (aalta_formula::af_prt_set::iterator it = P3.begin (); it != P3.end (); it ++)
+   f2 = convert_to_formula (P4);
+   if (f2 != NULL)
    {
-     if (_globals.find (*it) != _globals.end ())
-       continue;
-     P2.erase (*it);
-     f2 = convert_to_formula (P2);
-     if (f2 == NULL)
-       return NULL;
      f2 = f2->flatted ();
      if (nx != NULL)
        f2 = aalta_formula (aalta_formula::And, f2, nx).unique ();
-     P4 = f2->SAT ();
-     count ++;
-     if (!P4.empty ())
-     {
-       P.insert (*it);
-       P2.insert (*it);
-     }
-   }
-   //if (!P.empty ())
-     //update_history (ucore, P);
    }
-   //printf ("nondeter_prog_state::MUC: do SAT %d times\n", count);
+   else
+     f2 = nx;
+   
+   if (!unsat_core (P3, f2, P5))
+     return convert_to_formula (P3);
    
-   aalta_formula *res = convert_to_formula (P);
+   aalta_formula *res = convert_to_formula (P5);
    return res;
  }
  
@@ -828,19 +699,20 @@
  aalta_formula::af_prt_set   
  nondeter_prog_state::UC (aalta_formula *f, aalta_formula *ucore)
  {
+   statistics::scope stats_site (statistics::UC);
    //ERASE_NODE (f);
    //printf ("before UC: the final ucore is\n%s\n", ucore->to_string ().c_str());
    assert (ucore != NULL);
    aalta_formula *temp = ucore;
-   _potential_unsat.erase (ucore);
+   session ()._potential_unsat.erase (ucore);
    aalta_formula *f2, *f3, *flat;
    flat = f->flatted ();
    
    aalta_formula::af_prt_set prop_atoms = propAtoms (flat);
    
-   if (_avoid != NULL)
-     flat = aalta_formula (aalta_formula::And, flat, _avoid).unique ();
-   f3 = OR (_potential_unsat);
+   if (session ()._avoid != NULL)
+     flat = aalta_formula (aalta_formula::And, flat, session ()._avoid).unique ();
+   f3 = OR (session ()._potential_unsat);
    if (f3 != NULL)
      flat = aalta_formula (aalta_formula::And, flat, negation_next (f3)).unique ();
      
@@ -869,7 +741,7 @@
    }
    else
      update_node (f, ucore, current_in (P), next_in (P, prop_atoms));
-   _potential_unsat.insert (ucore);
+   session ()._potential_unsat.insert (ucore);
    //printf ("after UC: the final ucore is\n%s\n", ucore->to_string ().c_str());
    return P;
    
@@ -884,16 +756,16 @@
    
    aalta_formula::af_prt_set prop_atoms = propAtoms (f2);
    
-   if (_avoid != NULL)
-     f2 = aalta_formula (aalta_formula::And, f2, _avoid).unique ();
-   f3 = OR (_unsatisfied);
+   if (session ()._avoid != NULL)
+     f2 = aalta_formula (aalta_formula::And, f2, session ()._avoid).unique ();
+   f3 = OR (session ()._unsatisfied);
    if (f3 != NULL)
      f2 = aalta_formula (aalta_formula::And, f2, f3).unique ();
    aalta_formula::af_prt_set P, P2, P3;
    P = f2->SAT ();
    if (P.empty ())
    {
-     P2 = UC (f, AND (_unsatisfied_untils));
+     P2 = UC (f, AND (session ()._unsatisfied_untils));
      if (P2.empty ())
      {
        UNSAT_INVARIANT_BACK ();
@@ -918,17 +790,17 @@
  bool 
  nondeter_prog_state::is_potential_unsat_invariant ()
  {
-   aalta_formula *f2 = OR (_potential_unsat);
+   aalta_formula *f2 = OR (session ()._potential_unsat);
    if (f2 == NULL)
      return false;
    aalta_formula *f3 = negation_next (f2);
-   aalta_formula *global = convert_to_formula (_globals);
+   aalta_formula *global = convert_to_formula (session ()._globals);
    if (global != NULL)
      f2 = aalta_formula (aalta_formula::And, f2, global).unique ();
    aalta_formula *f = f2->flatted ();
    f = aalta_formula (aalta_formula::And, f, f3).unique ();
-   if (_avoid != NULL)
-     f = aalta_formula (aalta_formula::And, f, _avoid).unique ();
+   if (session ()._avoid != NULL)
+     f = aalta_formula (aalta_formula::And, f, session ()._avoid).unique ();
    aalta_formula::af_prt_set P = f->SAT ();
    if (P.empty ())
      return true;
@@ -945,7 +817,7 @@
    std::vector<node*> nodes;
    if (is_potential_unsat_invariant ())
      return;
-   for (it = _f_node_map.begin (); it != _f_node_map.end (); it ++)
+   for (it = session ()._f_node_map.begin (); it != session ()._f_node_map.end (); it ++)
    {
      nodes.push_back (it->second);
    }
@@ -975,7 +847,6 @@
    //printf ("step out UNSAT_INVARIANT_BACK\n");
  }
  
- aalta_formula* nondeter_prog_state::_current_avoid = NULL;
  bool 
  nondeter_prog_state::imply_avoid ()
  {
@@ -1002,13 +873,14 @@
  std::pair<aalta_formula::af_prt_set, aalta_formula*> 
  nondeter_prog_state::get_next_pair (size_t pos)
  {
+   statistics::scope stats_site (statistics::NEXT_PAIR);
    //printf ("original formula is:\n%s\n\n", _formula->to_string().c_str ());                 
    //printf ("after flatten, the formula is:\n%s\n", _flatted_formula->to_string ().c_str ());
    
-   if (! _witness.empty ())
+   if (! session ()._witness.empty ())
    {
-     std::pair<aalta_formula::af_prt_set, aalta_formula*> pa = _witness.back ();
-     _witness.pop_back ();
+     std::pair<aalta_formula::af_prt_set, aalta_formula*> pa = session ()._witness.back ();
+     session ()._witness.pop_back ();
      return pa;
    }
    
@@ -1024,29 +896,29 @@
     *_next_wanted store all formulas we expect to see in next state
    */
    
-   if (_next_wanted != NULL)
+   if (session ()._next_wanted != NULL)
    {
      //printf ("_next_wanted is not NULL\n");
      //checker::print (_unsatisfied);
      //printf ("_next_wanted is\n%s\n", _next_wanted->to_string ().c_str ());
-     f = aalta_formula (aalta_formula::And, f, _next_wanted).unique ();
+     f = aalta_formula (aalta_formula::And, f, session ()._next_wanted).unique ();
      //printf ("_formula is\n%s\n", _formula->to_string ().c_str ());
      P = f->SAT ();
      if (!P.empty ())
      {
-       _fulfilled = false;   
+       session ()._fulfilled = false;   
        //printf ("return here\n");
        //printf ("_next_wanted is\n%s\n", _next_wanted->to_string ().c_str ());
-       _next_wanted = NULL;
+       session ()._next_wanted = NULL;
        return assignment_pair (P);
      }
      else
      {
-       _next_wanted = NULL;
+       session ()._next_wanted = NULL;
        f = _flatted_formula;
      }
      //printf ("cannot get an assignment from _next_wanted!\n");
-     _fulfilled = false;
+     session ()._fulfilled = false;
    }
    
    ///end of sat seeking part
@@ -1061,22 +933,32 @@
    
    
    
-   if (_avoid != NULL)
+   if (session ()._avoid != NULL)
    {
-     if (_avoid == aalta_formula::FALSE ())
+     if (session ()._avoid == aalta_formula::FALSE ())
      {
        return empty_pair ();
      }
      //printf ("_avoid is: %s\n", _avoid->to_string().c_str ());
-     f = aalta_formula (aalta_formula::And, f, _avoid).unique ();
+     f = aalta_formula (aalta_formula::And, f, session ()._avoid).unique ();
    }
    
+   //a state containing a learned core has no successor worth taking
+   if (session ()._cores.contains_core (_formula))
+   {
+     statistics::core_hits ++;
+     return empty_pair ();
+   }
+   
+   if (cached_pair (pa))
+     return pa;
+   
    P = f->SAT ();
    if (P.empty ())
    {
      //_formula is unsatisfiable itself
-     if (_last_invariant != NULL)
-       if (contain (_formula, _last_invariant))
+     if (session ()._last_invariant != NULL)
+       if (contain (_formula, session ()._last_invariant))
          return empty_pair ();
      if (imply_avoid ())
        return empty_pair ();
@@ -1089,21 +971,27 @@
        //checker::print (temp->to_set ());
      }
      else 
-       _avoid = aalta_formula::FALSE ();
+       session ()._avoid = aalta_formula::FALSE ();
        
      return empty_pair ();
    }
-   if (_unsatisfied.empty ())
+   if (session ()._unsatisfied.empty ())
+   {
+     cache_model (P);
      return assignment_pair (P);
+   }
    
    
-   f2 = OR (_unsatisfied);
+   f2 = OR (session ()._unsatisfied);
    //f = aalta_formula (aalta_formula::And, f, f2).unique ();
    f = aalta_formula (aalta_formula::And, f2, f).unique ();
    
    P = f->SAT ();
    if (!P.empty ())
+   {
+     cache_model (P);
      return assignment_pair (P);
+   }
    else
    {
    /*
@@ -1114,21 +1002,21 @@
    
    //check whether _global_flatted_formula is the reason causing _unsatisfied_untils not fulfilled
    //if so, we can know elements in _unsatisfied_untils are unsat.
-   if (_global_flatted_formula != NULL)
+   if (session ()._global_flatted_formula != NULL)
    {
-     aalta_formula* temp_f = create_check_formula (AND (_unsatisfied_untils), NULL);
-     temp_f = aalta_formula (aalta_formula::And, temp_f, OR (_unsatisfied)).unique ();
+     aalta_formula* temp_f = create_check_formula (AND (session ()._unsatisfied_untils), NULL);
+     temp_f = aalta_formula (aalta_formula::And, temp_f, OR (session ()._unsatisfied)).unique ();
      aalta_formula::af_prt_set temp_P = temp_f->SAT();
      if (temp_P.empty ())
      {
-       update_avoid_with (AND (_unsatisfied_untils));
+       update_avoid_with (AND (session ()._unsatisfied_untils));
        return empty_pair ();
      }
    }
    
    
-   assert (_f_node_map.empty ());
-   _unsat_root = _formula;
+   assert (session ()._f_node_map.empty ());
+   session ()._unsat_root = _formula;
    
    bool succeed = compute_next_pair_from_history (pa);
    if (succeed)
@@ -1141,8 +1029,8 @@
    aalta_formula::af_prt_set common = distinguish_states (visited);
    if (common.empty ())           //at least one element of _unsatisfied_untils is satisfied 
    {
-     pa = _witness.back ();
-     _witness.pop_back ();
+     pa = session ()._witness.back ();
+     session ()._witness.pop_back ();
      clear_f_node_map ();
      return pa;
    } 
@@ -1194,7 +1082,7 @@
          if (is_invariant (temp_f) && is_initially (temp_f))
          {
            update_global_flatted_formula (seq);
-           update_avoid_with (AND(_unsatisfied_untils));
+           update_avoid_with (AND(session ()._unsatisfied_untils));
          }
          else
          {
@@ -1225,7 +1113,7 @@
      if (pos == 0)
      {
        f_to_check = create_check_formula (visited, NULL);
-       f_to_check = aalta_formula (aalta_formula::And, f_to_check, OR (_unsatisfied)).unique ();
+       f_to_check = aalta_formula (aalta_formula::And, f_to_check, OR (session ()._unsatisfied)).unique ();
      }
      else
        f_to_check = create_check_formula (visited, OR (seq[pos]));
@@ -1239,9 +1127,9 @@
        if (pos < 0)
        {
          fill_witness_from_to (pre_state);
-         assert (!_witness.empty ());
-         pa = _witness.back ();
-         _witness.pop_back ();
+         assert (!session ()._witness.empty ());
+         pa = session ()._witness.back ();
+         session ()._witness.pop_back ();
          clear_f_node_map ();
          update_until_avoid_seqs (P, seq);
          update_pre_seq_hist (P, seq);
@@ -1256,7 +1144,7 @@
        {
          f_to_check = create_check_formula (visited, NULL);
          //f_to_check = aalta_formula (aalta_formula::And, f_to_check, OR (_unsatisfied)).unique ();
-         f_to_check = aalta_formula (aalta_formula::And, OR (_unsatisfied), f_to_check).unique ();
+         f_to_check = aalta_formula (aalta_formula::And, OR (session ()._unsatisfied), f_to_check).unique ();
        }
        else
          f_to_check = create_check_formula (visited, OR (seq[pos]));
@@ -1274,12 +1162,12 @@
  {
    std::vector<aalta_formula::af_prt_set > seq;
    hash_map<aalta_formula*, std::vector<aalta_formula::af_prt_set > >::iterator iter;
-   if (_pre_seq_hist.empty ())
+   if (session ()._pre_seq_hist.empty ())
    {
-     for (aalta_formula::af_prt_set::iterator it = _unsatisfied_untils.begin (); it != _unsatisfied_untils.end (); it ++)
+     for (aalta_formula::af_prt_set::iterator it = session ()._unsatisfied_untils.begin (); it != session ()._unsatisfied_untils.end (); it ++)
      {
-       iter = _until_avoid_seqs.find (*it);
-       if (iter != _until_avoid_seqs.end ())
+       iter = session ()._until_avoid_seqs.find (*it);
+       if (iter != session ()._until_avoid_seqs.end ())
        {
          seq = iter->second;
          //printf ("compute_next_pair_from_history:: use history from _until_avoid_seqs\n");
@@ -1291,7 +1179,7 @@
    }
    else
    {
-     seq = adjust_to_unsatisfied (_pre_seq_hist);
+     seq = adjust_to_unsatisfied (session ()._pre_seq_hist);
      if (seq.empty ())
        return false;
      //printf ("compute_next_pair_from_history:: use history from _pre_seq_hist\n");
@@ -1309,7 +1197,7 @@
    Q1 = Q2 = seq[0];
    for (aalta_formula::af_prt_set::iterator it = Q1.begin (); it != Q1.end (); it ++)
    {
-     if (_unsatisfied_untils.find (*it) == _unsatisfied_untils.end ())
+     if (session ()._unsatisfied_untils.find (*it) == session ()._unsatisfied_untils.end ())
        Q2.erase (*it);
    }
    if (Q2.empty ())
@@ -1332,7 +1220,7 @@
      if (pos == 0)
      {
        f_to_check = create_check_formula (visited, NULL);
-       f_to_check = aalta_formula (aalta_formula::And, f_to_check, OR (_unsatisfied)).unique ();
+       f_to_check = aalta_formula (aalta_formula::And, f_to_check, OR (session ()._unsatisfied)).unique ();
      }
      else
        f_to_check = create_check_formula (visited, OR (seq[pos]));
@@ -1346,9 +1234,9 @@
        if (pos < 0)
        {
          fill_witness_from_to (pre_state);
-         assert (!_witness.empty ());
-         pa = _witness.back ();
-         _witness.pop_back ();
+         assert (!session ()._witness.empty ());
+         pa = session ()._witness.back ();
+         session ()._witness.pop_back ();
          clear_f_node_map ();
          update_until_avoid_seqs (P, seq);
          update_pre_seq_hist (P, seq);
@@ -1366,7 +1254,7 @@
        {
          f_to_check = create_check_formula (visited, NULL);
          //f_to_check = aalta_formula (aalta_formula::And, f_to_check, OR (_unsatisfied)).unique ();
-         f_to_check = aalta_formula (aalta_formula::And, OR (_unsatisfied), f_to_check).unique ();
+         f_to_check = aalta_formula (aalta_formula::And, OR (session ()._unsatisfied), f_to_check).unique ();
        }
        else
          f_to_check = create_check_formula (visited, OR (seq[pos]));
@@ -1395,7 +1283,7 @@
          if (is_invariant (temp_f) && is_initially (temp_f))
          {
            update_global_flatted_formula (seq);
-           update_avoid_with (AND(_unsatisfied_untils));
+           update_avoid_with (AND(session ()._unsatisfied_untils));
          }
          else
          {
@@ -1427,28 +1315,26 @@
    
  }
  
- hash_map<aalta_formula*, std::vector<aalta_formula::af_prt_set> > nondeter_prog_state::_until_avoid_seqs;
  void 
  nondeter_prog_state::update_until_avoid_seqs (aalta_formula::af_prt_set& P, std::vector<aalta_formula::af_prt_set > seq)
  {
    aalta_formula::af_prt_set Q;
-   for (aalta_formula::af_prt_set::iterator it = _unsatisfied_untils.begin (); it != _unsatisfied_untils.end (); it ++)
+   for (aalta_formula::af_prt_set::iterator it = session ()._unsatisfied_untils.begin (); it != session ()._unsatisfied_untils.end (); it ++)
    {
      if (P.find ((*it)->get_var ()) != P.end ())
-       _until_avoid_seqs.erase (*it);
+       session ()._until_avoid_seqs.erase (*it);
      Q.clear ();
      Q.insert (*it);
      seq[0] = Q;
-     _until_avoid_seqs.insert (std::pair<aalta_formula*, std::vector<aalta_formula::af_prt_set > > (*it, seq));
+     session ()._until_avoid_seqs.insert (std::pair<aalta_formula*, std::vector<aalta_formula::af_prt_set > > (*it, seq));
    }
  }
  
- std::vector<aalta_formula::af_prt_set> nondeter_prog_state::_pre_seq_hist;
  void 
  nondeter_prog_state::update_pre_seq_hist (aalta_formula::af_prt_set& P, std::vector<aalta_formula::af_prt_set > seq)
  {
-   aalta_formula::af_prt_set Q = _unsatisfied_untils;
-   for (aalta_formula::af_prt_set::iterator it = _unsatisfied_untils.begin (); it != _unsatisfied_untils.end (); it ++)
+   aalta_formula::af_prt_set Q = session ()._unsatisfied_untils;
+   for (aalta_formula::af_prt_set::iterator it = session ()._unsatisfied_untils.begin (); it != session ()._unsatisfied_untils.end (); it ++)
    {
      if (P.find ((*it)->get_var ()) != P.end ())
        Q.erase (*it);
@@ -1458,31 +1344,30 @@
    {
      Q2.insert (AND (Q));
      seq[0] = Q2;
-     _pre_seq_hist = seq;
+     session ()._pre_seq_hist = seq;
    }
    else
-     _pre_seq_hist.clear ();
+     session ()._pre_seq_hist.clear ();
    //printf ("_pre_seq_hist is set!\n");
    //print_seq (_pre_seq_hist);
  }
  
  //store the original input formula
- aalta_formula* nondeter_prog_state::_input_flatted = NULL;
  
  void 
  nondeter_prog_state::set_input_flatted ()
  {
-   if (_input_flatted == NULL)
-     _input_flatted = _flatted_formula;
+   if (session ()._input_flatted == NULL)
+     session ()._input_flatted = _flatted_formula;
  }
  //check whether f is true initially
  bool 
  nondeter_prog_state::is_initially (aalta_formula* f)
  {
-   assert (_input_flatted != NULL);
+   assert (session ()._input_flatted != NULL);
    aalta_formula *flat = f->flatted ();
    flat = aalta_formula (aalta_formula::Not, NULL, flat).unique ();
-   flat = aalta_formula (aalta_formula::And, _input_flatted, flat).unique ();
+   flat = aalta_formula (aalta_formula::And, session ()._input_flatted, flat).unique ();
    aalta_formula::af_prt_set P = flat->SAT ();
    if (P.empty ())
      return true;
@@ -1494,23 +1379,23 @@
  
  //update _global_flatted_formula
  void 
- nondeter_prog_state::update_global_flatted_formula (std::vector<aalta_formula::af_prt_set > seq)
+ nondeter_prog_state::update_global_flatted_formula (const std::vector<aalta_formula::af_prt_set >& seq)
  {
    for (int i = 1; i < seq.size (); i ++)
    {
-     if (_global_flatted_formula == NULL)
+     if (session ()._global_flatted_formula == NULL)
      {
-       _global_flatted_formula = OR (seq[i])->flatted ();
+       session ()._global_flatted_formula = OR (seq[i])->flatted ();
      }
      else
-       _global_flatted_formula = aalta_formula (aalta_formula::And, _global_flatted_formula, OR (seq[i])->flatted ()).unique ();
+       session ()._global_flatted_formula = aalta_formula (aalta_formula::And, session ()._global_flatted_formula, OR (seq[i])->flatted ()).unique ();
    }
    //printf ("after update _always_true is \n%s\n", _always_true->to_string ().c_str ());
  }
  
  //print the information of seq
  void 
- nondeter_prog_state::print_seq (std::vector<aalta_formula::af_prt_set > seq)
+ nondeter_prog_state::print_seq (const std::vector<aalta_formula::af_prt_set >& seq)
  {
    for (int i = 0; i < seq.size (); i ++)
      checker::print (seq[i]);
@@ -1520,19 +1405,20 @@
  //compute minimal unsat cores from collected states. 
  //During the computation, existed information in the avoidabe sequence can be used. 
  aalta_formula::af_prt_set 
- nondeter_prog_state::compute_muc (aalta_formula::af_prt_set S, 
-                                   std::vector<aalta_formula::af_prt_set > seq, int pos)
+ nondeter_prog_state::compute_muc (const aalta_formula::af_prt_set& S, 
+                                   const std::vector<aalta_formula::af_prt_set >& seq, int pos)
  {
+   statistics::scope stats_site (statistics::MUC);
    aalta_formula::af_prt_set Q, res, temp, P;
    aalta_formula* ucore, *f, *guarantee_check, *f2;
    if (pos+1 < seq.size ())
      Q = seq[pos+1];
      
    //check whether there is one X(seq[pos]), if so, it is obvious an MUC
-   for (aalta_formula::af_prt_set::iterator it = seq[pos].begin (); it != seq[pos].end (); it ++)
+   for (aalta_formula::af_prt_set::const_iterator it = seq[pos].begin (); it != seq[pos].end (); it ++)
      P.insert (apply_next (*it));
 
-   for (aalta_formula::af_prt_set::iterator it = S.begin (); it != S.end (); it ++)
+   for (aalta_formula::af_prt_set::const_iterator it = S.begin (); it != S.end (); it ++)
    {
      //printf ("in compute_muc, the formula is\n%s\n", (*it)->to_string().c_str ());
      f = erase_global (*it);
@@ -1572,6 +1458,7 @@
  aalta_formula::af_prt_set 
  nondeter_prog_state::MUC_set (aalta_formula *f, aalta_formula::af_prt_set Q, aalta_formula *avoid)
  {
+   statistics::scope stats_site (statistics::MUC);
    //printf ("before muc_set, the formula f is \n%s\n", f->to_string().c_str ());
    aalta_formula::af_prt_set res, res1, P;
    aalta_formula *temp, *to_check_formula, *ucore;
@@ -1632,9 +1519,9 @@
  
  //check whether there is one formula f' in Q such that elements of f' are included in f  
  bool 
- nondeter_prog_state::contain_one_of (aalta_formula *f, aalta_formula::af_prt_set Q)
+ nondeter_prog_state::contain_one_of (aalta_formula *f, const aalta_formula::af_prt_set& Q)
  {
-   for (aalta_formula::af_prt_set::iterator it = Q.begin (); it != Q.end (); it ++)
+   for (aalta_formula::af_prt_set::const_iterator it = Q.begin (); it != Q.end (); it ++)
    {
      if (contain (f, *it))
        return true;
@@ -1659,7 +1546,7 @@
  
  //initial the avoidable sequence
  void 
- nondeter_prog_state::initial_seq (std::vector<aalta_formula::af_prt_set >& seq, aalta_formula::af_prt_set common)
+ nondeter_prog_state::initial_seq (std::vector<aalta_formula::af_prt_set >& seq, const aalta_formula::af_prt_set& common)
  {
    /*
    aalta_formula *guarantee_check = create_check_formula (AND (common), NULL);
@@ -1673,7 +1560,7 @@
    }
    */
    aalta_formula::af_prt_set q0;
-   q0.insert (AND (_unsatisfied_untils));
+   q0.insert (AND (session ()._unsatisfied_untils));
    seq.push_back (q0);
    int pos = 0;
    aalta_formula *current_avoid = OR (seq[pos]);
@@ -1714,7 +1601,7 @@
  
  //update avoid due to whether pos or seq changes
  aalta_formula* 
- nondeter_prog_state::update_avoid (std::vector<aalta_formula::af_prt_set > seq, int pos)
+ nondeter_prog_state::update_avoid (const std::vector<aalta_formula::af_prt_set >& seq, int pos)
  {
    aalta_formula *res = NULL;
    aalta_formula::af_prt_set Q;
@@ -1731,7 +1618,7 @@
  
  //update the information of avoidable sequence
  void 
- nondeter_prog_state::update_seq (std::vector<aalta_formula::af_prt_set >& seq, aalta_formula::af_prt_set S, int pos)
+ nondeter_prog_state::update_seq (std::vector<aalta_formula::af_prt_set >& seq, const aalta_formula::af_prt_set& S, int pos)
  {
    aalta_formula::af_prt_set Q;
    if (seq.size () > pos)
@@ -1779,7 +1666,7 @@
    
    aalta_formula *next_state, *f2, *pre_state;
    aalta_formula::af_prt_set prop_atoms, P2;
-   f2 = aalta_formula (aalta_formula::Or, OR (_unsatisfied), negation_next (AND (common))).unique ();
+   f2 = aalta_formula (aalta_formula::Or, OR (session ()._unsatisfied), negation_next (AND (common))).unique ();
    aalta_formula *f_to_check = create_check_formula (S, NULL);
    f_to_check = aalta_formula (aalta_formula::And, f2, f_to_check).unique ();
    aalta_formula::af_prt_set P = f_to_check->SAT ();
@@ -1792,14 +1679,14 @@
 
      assert (pre_state != NULL);
      next_state = next_in (P, pre_state->flatted ());
-     for (it = _unsatisfied.begin (); it != _unsatisfied.end (); it ++)
+     for (it = session ()._unsatisfied.begin (); it != session ()._unsatisfied.end (); it ++)
      {
        if (P.find (*it) != P.end ())
        {
          common.clear ();
          //printf ("distinguish_states::pre_state is \n%s\n", pre_state->to_string ().c_str ());
          fill_witness_from_to (pre_state);
-         assert (!_witness.empty ());
+         assert (!session ()._witness.empty ());
          //printf ("after distinguish_state, the number of states is %d\n", (int)S.size ());
          //printf ("after distinguish_state, the number of _witness is %d\n", (int)_witness.size ());
          return common;
@@ -1810,13 +1697,13 @@
      
      
      f_to_check = create_check_formula (erase_global (next_state), NULL);
-     f_to_check = aalta_formula (aalta_formula::And, OR (_unsatisfied), f_to_check).unique ();
+     f_to_check = aalta_formula (aalta_formula::And, OR (session ()._unsatisfied), f_to_check).unique ();
      P = f_to_check->SAT ();
      if (!P.empty ())
      {
        common.clear ();
        fill_witness_from_to (next_state);
-         assert (!_witness.empty ());
+         assert (!session ()._witness.empty ());
          //printf ("after distinguish_state, the number of states is %d\n", (int)S.size ());
          //printf ("after distinguish_state, the number of _witness is %d\n", (int)_witness.size ());
          return common;
@@ -1824,7 +1711,7 @@
      
 
      common = intersect (common, next_state->to_set ());
-     f2 = aalta_formula (aalta_formula::Or, OR (_unsatisfied), negation_next (AND (common))).unique ();
+     f2 = aalta_formula (aalta_formula::Or, OR (session ()._unsatisfied), negation_next (AND (common))).unique ();
 
      f_to_check = create_check_formula (S, NULL);
      f_to_check = aalta_formula (aalta_formula::And, f2, f_to_check).unique ();
@@ -1867,10 +1754,10 @@
  
  //intersection between set P1 and P2
  aalta_formula::af_prt_set 
- nondeter_prog_state::intersect (aalta_formula::af_prt_set P1, aalta_formula::af_prt_set P2)
+ nondeter_prog_state::intersect (const aalta_formula::af_prt_set& P1, const aalta_formula::af_prt_set& P2)
  {
    aalta_formula::af_prt_set res;
-   for (aalta_formula::af_prt_set::iterator it = P1.begin (); it != P1.end (); it ++)
+   for (aalta_formula::af_prt_set::const_iterator it = P1.begin (); it != P1.end (); it ++)
    {
      if (P2.find (*it) != P2.end ())
        res.insert (*it);
@@ -1888,28 +1775,28 @@
      flat = cur->flatted ();
      if (not_next != NULL)
        flat = aalta_formula (aalta_formula::And, flat, negation_next (not_next)).unique ();
-     if (_global_flatted_formula != NULL)
-       flat = aalta_formula (aalta_formula::And, flat, _global_flatted_formula).unique ();
-     if (_avoid != NULL)
-       flat = aalta_formula (aalta_formula::And, flat, _avoid).unique (); 
+     if (session ()._global_flatted_formula != NULL)
+       flat = aalta_formula (aalta_formula::And, flat, session ()._global_flatted_formula).unique ();
+     if (session ()._avoid != NULL)
+       flat = aalta_formula (aalta_formula::And, flat, session ()._avoid).unique (); 
    }
    else
    {
      if (not_next != NULL)
        flat = negation_next (not_next);
-     if (_global_flatted_formula != NULL)
+     if (session ()._global_flatted_formula != NULL)
      {
        if (flat != NULL)
-         flat = aalta_formula (aalta_formula::And, flat, _global_flatted_formula).unique ();
+         flat = aalta_formula (aalta_formula::And, flat, session ()._global_flatted_formula).unique ();
        else 
-         flat = _global_flatted_formula;
+         flat = session ()._global_flatted_formula;
      }
-     if (_avoid != NULL)
+     if (session ()._avoid != NULL)
      {
        if (flat != NULL)
-         flat = aalta_formula (aalta_formula::And, flat, _avoid).unique ();
+         flat = aalta_formula (aalta_formula::And, flat, session ()._avoid).unique ();
        else
-         flat = _avoid; 
+         flat = session ()._avoid; 
      }
    }
     
@@ -1917,7 +1804,7 @@
  }
  
  aalta_formula* 
- nondeter_prog_state::create_check_formula (aalta_formula::af_prt_set S, aalta_formula *not_next)
+ nondeter_prog_state::create_check_formula (const aalta_formula::af_prt_set& S, aalta_formula *not_next)
  {
    aalta_formula::af_prt_set::const_iterator it;
    aalta_formula::af_prt_set P;
@@ -1931,34 +1818,34 @@
    return create_check_formula (OR (P), not_next);
  }
 
- aalta_formula::af_prt_set nondeter_prog_state::_avoids;
- aalta_formula* nondeter_prog_state::_last_invariant = NULL;
+ //_avoid keeps the cores that _cores drops as redundant: rebuilding it
+ //would give new formulas that the SAT context has to encode again
  void 
  nondeter_prog_state::update_avoid_with (aalta_formula *f)
  {
    if (f == NULL)
    {
-     _avoid = aalta_formula::FALSE ();
-     _current_avoid = _avoid;
+     session ()._avoid = aalta_formula::FALSE ();
+     session ()._current_avoid = session ()._avoid;
    }
-   else if (_avoid == NULL)
+   else if (session ()._avoid == NULL)
    {
-     _avoid = negation_next (f);
-     _current_avoid = f;
+     session ()._cores.add (f);
+     session ()._avoid = negation_next (f);
+     session ()._current_avoid = f;
    }
    else
    {
-     if (_avoids.find (f) == _avoids.end ())
+     if (session ()._cores.add (f))
      {
-       _avoid = aalta_formula (aalta_formula::And, _avoid, negation_next (f)).unique ();
-       if (_current_avoid == NULL)
-         _current_avoid = f;
+       session ()._avoid = aalta_formula (aalta_formula::And, session ()._avoid, negation_next (f)).unique ();
+       if (session ()._current_avoid == NULL)
+         session ()._current_avoid = f;
        else
-         _current_avoid = aalta_formula (aalta_formula::And, _current_avoid, f).unique ();
-       _avoids.insert (f);
+         session ()._current_avoid = aalta_formula (aalta_formula::And, session ()._current_avoid, f).unique ();
      }
    }
-   _last_invariant = f;
+   session ()._last_invariant = f;
    
  }
  
@@ -1970,10 +1857,9 @@
    return std::make_pair (P, aalta_formula::FALSE ());
  }
  
- bool nondeter_prog_state::_no_until_fulfilled = true;
  
  std::pair<aalta_formula::af_prt_set, aalta_formula*> 
- nondeter_prog_state::assignment_pair (aalta_formula::af_prt_set P)
+ nondeter_prog_state::assignment_pair (const aalta_formula::af_prt_set& P)
  {
    aalta_formula *f2 = convert_to_formula (P);
    //f2 = erase_next_global (f2);
@@ -1989,23 +1875,23 @@
      f2 = f2->r_af ();
    else
      f2 = aalta_formula (aalta_formula::Not, NULL, f2).unique ();
-   if (_unsatisfied.empty ())
+   if (session ()._unsatisfied.empty ())
    {
-     _unsatisfied = get_until_element_of (nx);
-     _no_until_fulfilled = true;
+     session ()._unsatisfied = get_until_element_of (nx);
+     session ()._no_until_fulfilled = true;
    }
    else
    {
      for (aalta_formula::af_prt_set::iterator it = P2.begin (); it != P2.end (); it ++)
      {
        //printf ("%s\n", (*it)->to_string ().c_str ());
-       if (_unsatisfied.find (*it) != _unsatisfied.end ())
-         _unsatisfied.erase (*it);
+       if (session ()._unsatisfied.find (*it) != session ()._unsatisfied.end ())
+         session ()._unsatisfied.erase (*it);
      }
-     if (_unsatisfied.empty ())
+     if (session ()._unsatisfied.empty ())
      {
-       _no_until_fulfilled = false;
-       _pre_seq_hist.clear ();
+       session ()._no_until_fulfilled = false;
+       session ()._pre_seq_hist.clear ();
      }
    }
    //printf ("after nondeter_prog_state::get_next_pair::_unsatisfied:\n");
@@ -2028,7 +1914,6 @@
    return true;
  }
  
- aalta_formula* nondeter_prog_state::_global_flatted_formula = NULL;
  
  void 
  nondeter_prog_state::set_global ()
@@ -2037,11 +1922,11 @@
    for (aalta_formula::af_prt_set::iterator it = P.begin (); it != P.end (); it ++)
    {
      if ((*it)->oper () == aalta_formula::Release && (*it)->l_af() == aalta_formula::FALSE ())
-       _globals.insert (*it);
+       session ()._globals.insert (*it);
    }
-   _global_flatted_formula = convert_to_formula (_globals);
-   if (_global_flatted_formula != NULL)
-     _global_flatted_formula = _global_flatted_formula->flatted ();
+   session ()._global_flatted_formula = convert_to_formula (session ()._globals);
+   if (session ()._global_flatted_formula != NULL)
+     session ()._global_flatted_formula = session ()._global_flatted_formula->flatted ();
  }
  
  aalta_formula* 
@@ -2072,7 +1957,7 @@
    }
    else
    {
-     if (f->is_globally () && _globals.find (f) != _globals.end ())
+     if (f->is_globally () && session ()._globals.find (f) != session ()._globals.end ())
        res = NULL;
      else
        res = f;
@@ -2083,11 +1968,10 @@
 
  
  aalta_formula* 
- nondeter_prog_state::convert_to_formula (aalta_formula::af_prt_set P)
+ nondeter_prog_state::convert_to_formula (const aalta_formula::af_prt_set& P)
  {
-   aalta_formula *result = NULL;
    aalta_formula::af_prt_set temp;
-   aalta_formula::af_prt_set::iterator it;
+   aalta_formula::af_prt_set::const_iterator it;
    //remove the negative Next formulas, i.e. !(X a)
    for (it = P.begin (); it != P.end (); it ++)
    {
@@ -2107,22 +1991,20 @@
        //assert ((*it)->oper () != aalta_formula::And);
        //assert ((*it)->oper () != aalta_formula::Or);
      }
-     if (result == NULL)
-       result = *it;
-     else
-       result = aalta_formula (aalta_formula::And, result, *it).unique ();
+     temp.insert (*it);
    } 
 
-   return result;
+   //the same set gives the same formula, whatever its iteration order
+   return aalta_formula::merge (aalta_formula::And, temp);
  }
  
  aalta_formula* 
- nondeter_prog_state::generate_constraint (aalta_formula::af_prt_set P)
+ nondeter_prog_state::generate_constraint (const aalta_formula::af_prt_set& P)
  {
    aalta_formula *result = NULL;
    if (P.empty ())
      return NULL;
-   aalta_formula::af_prt_set::iterator it = P.begin ();
+   aalta_formula::af_prt_set::const_iterator it = P.begin ();
    result = *it;
    it ++;
    for (; it != P.end (); it ++)
@@ -2134,10 +2016,10 @@
  }
  
  aalta_formula::af_prt_set 
- nondeter_prog_state::current_in (aalta_formula::af_prt_set P)
+ nondeter_prog_state::current_in (const aalta_formula::af_prt_set& P)
  {
    aalta_formula::af_prt_set result;
-   for (aalta_formula::af_prt_set::iterator it = P.begin (); it != P.end (); it ++)
+   for (aalta_formula::af_prt_set::const_iterator it = P.begin (); it != P.end (); it ++)
    {
      if ((*it)->oper () > aalta_formula::Undefined)
        result.insert (*it);
@@ -2179,11 +2061,11 @@
  
  
  aalta_formula* 
- nondeter_prog_state::next_in (aalta_formula::af_prt_set P, aalta_formula::af_prt_set prop_atoms)
+ nondeter_prog_state::next_in (const aalta_formula::af_prt_set& P, const aalta_formula::af_prt_set& prop_atoms)
  {
    aalta_formula *result = NULL, *l, *r;
    aalta_formula::af_prt_set P2;
-   for (aalta_formula::af_prt_set::iterator it = P.begin (); it != P.end (); it ++)
+   for (aalta_formula::af_prt_set::const_iterator it = P.begin (); it != P.end (); it ++)
    {
      //printf ("%s\n", (*it)->to_string ().c_str ());
      if ((*it)->oper () == aalta_formula::Next && prop_atoms.find (*it) != prop_atoms.end ())
@@ -2242,20 +2124,206 @@
    return res;
    
  }
+
+ /*
+  * get_next_pair finds one successor of the state per call, and the
+  * queries for the next one differ only by what _avoid has learned
+  * since. The models found for a state are kept in the order they were
+  * found, and a state expanded again (on another path, or after a
+  * backtrack) walks them from _resume before asking the SAT solver: a
+  * model is taken if it still satisfies the current _avoid and, when
+  * there are unsatisfied untils, one of them. The states are kept in an
+  * LRU list of _successor_cache entries; 0 turns the cache off.
+  */
+ size_t nondeter_prog_state::_successor_cache = 0;
+ 
+ void 
+ nondeter_prog_state::set_successor_cache (size_t states)
+ {
+   _successor_cache = states;
+ }
+ 
+ //whether f (or its negation when !positive) is true in model m;
+ //an atom m does not assign is neither
+ bool 
+ nondeter_prog_state::holds (const successor_model& m, aalta_formula *f, bool positive)
+ {
+   switch (f->oper ())
+   {
+     case aalta_formula::True:
+       return positive;
+     case aalta_formula::False:
+       return !positive;
+     case aalta_formula::Not:
+       return holds (m, f->r_af (), !positive);
+     case aalta_formula::And:
+       if (positive)
+         return holds (m, f->l_af (), true) && holds (m, f->r_af (), true);
+       return holds (m, f->l_af (), false) || holds (m, f->r_af (), false);
+     case aalta_formula::Or:
+       if (positive)
+         return holds (m, f->l_af (), true) || holds (m, f->r_af (), true);
+       return holds (m, f->l_af (), false) && holds (m, f->r_af (), false);
+     default:
+       if (positive)
+         return m.assignment.find (f) != m.assignment.end ();
+       return m.falses.find (f) != m.falses.end ();
+   }
+ }
+ 
+ bool 
+ nondeter_prog_state::cached_pair (std::pair<aalta_formula::af_prt_set, aalta_formula*>& pa)
+ {
+   if (_successor_cache == 0)
+     return false;
+   hash_map<aalta_formula*, successor_list::iterator, aalta_formula::af_prt_hash>::iterator it;
+   it = session ()._successor_index.find (_formula);
+   if (it != session ()._successor_index.end ())
+   {
+     session ()._successors.splice (session ()._successors.begin (), session ()._successors, it->second);
+     std::vector<successor_model>& models = it->second->models;
+     aalta_formula *unsat = session ()._unsatisfied.empty () ? NULL : OR (session ()._unsatisfied);
+     for (; _resume < models.size (); _resume ++)
+     {
+       if (session ()._avoid != NULL && !holds (models[_resume], session ()._avoid, true))
+         continue;
+       if (unsat != NULL && !holds (models[_resume], unsat, true))
+         continue;
+       statistics::successor_cache_hits ++;
+       pa = assignment_pair (models[_resume ++].assignment);
+       return true;
+     }
+   }
+   statistics::successor_cache_misses ++;
+   return false;
+ }
+ 
+ //keep the model P found for the state
+ void 
+ nondeter_prog_state::cache_model (const aalta_formula::af_prt_set& P)
+ {
+   if (_successor_cache == 0)
+     return;
+   hash_map<aalta_formula*, successor_list::iterator, aalta_formula::af_prt_hash>::iterator it;
+   it = session ()._successor_index.find (_formula);
+   if (it == session ()._successor_index.end ())
+   {
+     successor_entry e;
+     e.state = _formula;
+     session ()._successors.push_front (e);
+     it = session ()._successor_index.insert (std::make_pair (_formula, session ()._successors.begin ())).first;
+     if (session ()._successors.size () > _successor_cache)
+     {
+       session ()._successor_index.erase (session ()._successors.back ().state);
+       session ()._successors.pop_back ();
+     }
+   }
+   else
+     session ()._successors.splice (session ()._successors.begin (), session ()._successors, it->second);
+   std::vector<successor_model>& models = it->second->models;
+   if (models.size () < SUCCESSOR_MODELS)
+   {
+     successor_model m;
+     m.assignment = P;
+     for (aalta_formula::af_prt_set::const_iterator pit = P.begin (); pit != P.end (); pit ++)
+       if ((*pit)->oper () == aalta_formula::Not)
+         m.falses.insert ((*pit)->r_af ());
+     models.push_back (m);
+   }
+   _resume = models.size ();
+ }
  
  
  
 
  
+ nondeter_prog_state::session_data::session_data ()
+ {
+   _avoid = NULL;
+   _global_not_set = true;
+   _invariant_found = false;
+   _fulfilled = false;
+   _next_wanted = NULL;
+   _fill_witness_already_done = false;
+   _unsat_root = NULL;
+   _global_flatted_formula = NULL;
+   _last_invariant = NULL;
+   _input_flatted = NULL;
+   _no_until_fulfilled = true;
+   _current_avoid = NULL;
+ }
+ 
+ nondeter_prog_state::session_data::~session_data ()
+ {
+   hash_map<aalta_formula*, node*, aalta_formula::af_prt_hash>::iterator it;
+   for (it = _f_node_map.begin (); it != _f_node_map.end (); it ++)
+     delete it->second;
+ }
+ 
  void 
- nondeter_prog_state::destroy ()
+ nondeter_prog_state::mark () const
  {
- /*
-   std::vector<nondeter_prog_state*>::iterator it;
-   for(it = _all_progfs.begin (); it != _all_progfs.end (); it ++)
+   aalta_formula::mark (_formula);
+   aalta_formula::mark (_flatted_formula);
+   aalta_formula::mark (_prop_atoms);
+   aalta_formula::mark (_constraints);
+   aalta_formula::mark (_assignments);
+ }
+ 
+ void 
+ nondeter_prog_state::session_data::mark () const
+ {
+   aalta_formula *afs[] = {_avoid, _next_wanted, _unsat_root, _global_flatted_formula, 
+                           _last_invariant, _input_flatted, _current_avoid};
+   for (int i = 0; i < sizeof (afs) / sizeof (afs[0]); i ++)
+     aalta_formula::mark (afs[i]);
+   std::vector<aalta_formula*> cores = _cores.cores ();
+   for (int i = 0; i < cores.size (); i ++)
+     aalta_formula::mark (cores[i]);
+   aalta_formula::mark (_unsatisfied);
+   aalta_formula::mark (_globals);
+   aalta_formula::mark (_unsatisfied_untils);
+   aalta_formula::mark (_potential_unsat);
+   for (history_map::const_iterator it = _hist_map.begin (); it != _hist_map.end (); it ++)
    {
-     delete *it;
+     aalta_formula::mark (it->first);
+     for (int i = 0; i < it->second.size (); i ++)
+       aalta_formula::mark (it->second[i]);
    }
-   */
+   hash_map<aalta_formula*, std::vector<aalta_formula::af_prt_set> >::const_iterator sit;
+   for (sit = _until_avoid_seqs.begin (); sit != _until_avoid_seqs.end (); sit ++)
+   {
+     aalta_formula::mark (sit->first);
+     for (int i = 0; i < sit->second.size (); i ++)
+       aalta_formula::mark (sit->second[i]);
+   }
+   for (int i = 0; i < _pre_seq_hist.size (); i ++)
+     aalta_formula::mark (_pre_seq_hist[i]);
+   for (successor_list::const_iterator lit = _successors.begin (); lit != _successors.end (); lit ++)
+   {
+     aalta_formula::mark (lit->state);
+     for (int i = 0; i < lit->models.size (); i ++)
+       aalta_formula::mark (lit->models[i].assignment);
+   }
+   for (int i = 0; i < _witness.size (); i ++)
+   {
+     aalta_formula::mark (_witness[i].first);
+     aalta_formula::mark (_witness[i].second);
+   }
+   hash_map<aalta_formula*, node*, aalta_formula::af_prt_hash>::const_iterator nit;
+   for (nit = _f_node_map.begin (); nit != _f_node_map.end (); nit ++)
+   {
+     aalta_formula::mark (nit->first);
+     aalta_formula::mark (nit->second->_formula);
+     aalta_formula::mark (nit->second->_ucore);
+     aalta_formula::mark (nit->second->_tran.first);
+     aalta_formula::mark (nit->second->_tran.second);
+   }
+ }
+ 
+ nondeter_prog_state::session_data& 
+ nondeter_prog_state::session ()
+ {
+   return *solver_session::current ()._prog_states;
  }
  
@@ -13,7 +13,9 @@
 
 #include "formula/aalta_formula.h"
 #include "util/utility.h"
+#include "core_store.h"
 #include <vector>
+#include <list>
 
 class node
 {
@@ -34,16 +36,17 @@ class nondeter_prog_state
     nondeter_prog_state (aalta_formula* af); 
     ~nondeter_prog_state (){}
     //nondeter_prog_state* clone ();
-    static aalta_formula* convert_to_formula (aalta_formula::af_prt_set);
+    static aalta_formula* convert_to_formula (const aalta_formula::af_prt_set&);
     //aalta_formula* add_constraint ();
     //void set_constraint (aalta_formula *f) {_constraints = f;}
     std::pair<aalta_formula::af_prt_set, aalta_formula*> get_next_pair (size_t);
-    std::pair<aalta_formula::af_prt_set, aalta_formula*> assignment_pair (aalta_formula::af_prt_set);
+    std::pair<aalta_formula::af_prt_set, aalta_formula*> assignment_pair (const aalta_formula::af_prt_set&);
     std::pair<aalta_formula::af_prt_set, aalta_formula*> empty_pair ();
     void update_avoid_with (aalta_formula*);
+    void mark () const;   //the formulas of the state, for a collection
     
-    aalta_formula::af_prt_set current_in (aalta_formula::af_prt_set);
-    aalta_formula* next_in (aalta_formula::af_prt_set, aalta_formula::af_prt_set);
+    aalta_formula::af_prt_set current_in (const aalta_formula::af_prt_set&);
+    aalta_formula* next_in (const aalta_formula::af_prt_set&, const aalta_formula::af_prt_set&);
     
     
     static aalta_formula::af_prt_set get_until_element_of (aalta_formula*);
@@ -61,43 +64,96 @@ class nondeter_prog_state
     //typedef hash_set<nondeter_prog_state*, progf_prt_hash, progf_prt_eq> progf_set;
     //nondeter_prog_state* unique ();
     //bool find (aalta_formula*);
-    static void destroy ();
     //static bool confirm_unsat_scc ();
     //static void reset_potential ();
     //static aalta_formula::af_prt_set get_potential () {return _potentials;}
     //static bool _potential;
     //static bool is_potential () {return _potential;}
-    static aalta_formula::af_prt_set unsatisfied () {return _unsatisfied;}
+    static aalta_formula::af_prt_set unsatisfied () {return session ()._unsatisfied;}
     static void initial_unsatisfied (aalta_formula*);
-    static void set_next_wanted (aalta_formula *f) {_next_wanted = f;}  //set _next_wanted
+    static void set_next_wanted (aalta_formula *f) {session ()._next_wanted = f;}  //set _next_wanted
     
-    static aalta_formula::af_prt_set global () {return _globals;}
-    static bool fulfilled () {return _fulfilled;}
+    static aalta_formula::af_prt_set global () {return session ()._globals;}
+    static bool fulfilled () {return session ()._fulfilled;}
     static aalta_formula *erase_global (aalta_formula*);
     
+    typedef std::vector<aalta_formula::af_prt_set > history_vec;
+    typedef hash_map<aalta_formula*, history_vec > history_map;
+    
+    //the models get_next_pair found for a state, see cached_pair
+    static void set_successor_cache (size_t);  //number of states, 0 for no cache
+    struct successor_model
+    {
+      aalta_formula::af_prt_set assignment;
+      aalta_formula::af_prt_set falses;   //the atoms assigned false
+    };
+    struct successor_entry
+    {
+      aalta_formula *state;
+      std::vector<successor_model> models;   //in the order they were found
+    };
+    typedef std::list<successor_entry> successor_list;
+    
+    //the progression state of one checking run, owned by a solver_session
+    struct session_data
+    {
+      session_data ();
+      ~session_data ();
+      aalta_formula* _avoid;              //explored formula avoid to be visited in next state
+      core_store _cores;                  //the cores forbidden by _avoid
+      aalta_formula::af_prt_set _unsatisfied;
+      aalta_formula::af_prt_set _globals;
+      bool _global_not_set;
+      //for implementation reason, _invariant_found is used to flag the current constraint is an invariant so as to be 
+      //considered to be unsat
+      bool _invariant_found;
+      //for implementation reason, _fulfilled is used to flag _unsatisfied is indeed eliminated
+      //rather than is originally empty
+      bool _fulfilled;
+      aalta_formula* _next_wanted;
+      history_map _hist_map;
+      bool _fill_witness_already_done;
+      aalta_formula::af_prt_set _unsatisfied_untils;
+      aalta_formula::af_prt_set _potential_unsat;
+      aalta_formula* _unsat_root;
+      std::vector<std::pair<aalta_formula::af_prt_set, aalta_formula*> > _witness; 
+      hash_map<aalta_formula*, node*, aalta_formula::af_prt_hash> _f_node_map;
+      aalta_formula* _global_flatted_formula;
+      aalta_formula* _last_invariant;
+      aalta_formula* _input_flatted;
+      bool _no_until_fulfilled;
+      hash_map<aalta_formula*, std::vector<aalta_formula::af_prt_set> > _until_avoid_seqs;
+      std::vector<aalta_formula::af_prt_set> _pre_seq_hist;
+      aalta_formula* _current_avoid;
+      successor_list _successors;   //most recently used first
+      hash_map<aalta_formula*, successor_list::iterator, aalta_formula::af_prt_hash> _successor_index;
+      void mark () const;
+    };
+    
   private:
+    static session_data& session ();
+    static size_t _successor_cache;
+    enum {SUCCESSOR_MODELS = 16};   //models kept for one state
+    
+    size_t _resume;   //the next cached model of the state to try
+    bool cached_pair (std::pair<aalta_formula::af_prt_set, aalta_formula*>&);
+    void cache_model (const aalta_formula::af_prt_set&);
+    static bool holds (const successor_model&, aalta_formula*, bool);
+    
     aalta_formula *_formula;              //formula before progression
     aalta_formula *_flatted_formula;      //formula after progression
     aalta_formula::af_prt_set _prop_atoms;
     aalta_formula::af_prt_set propAtoms (aalta_formula*);
    
-    static aalta_formula* _avoid;              //explored formula avoid to be visited in next state
-    static aalta_formula::af_prt_set _avoids;  //the set of elements in _avoid
     //static aalta_formula* _potential_explored; //potential explored formula avoid to be visited in next state
     aalta_formula *_constraints;          //formula stored the constraint of _formula
     aalta_formula *_assignments;          //formula recording assignments visisted so far
     
     //static aalta_formula::af_prt_set _potentials;
     //static aalta_formula::af_prt_set _potential_candidates;
-    static aalta_formula::af_prt_set _unsatisfied;
     
     //static std::vector<nondeter_prog_state*> _all_progfs;   //store all newed pointers
-    static aalta_formula::af_prt_set _globals;
-    static bool _global_not_set;
-    static bool _invariant_found;
-    static bool _fulfilled;
     
-    static aalta_formula* _next_wanted;
     
     //aalta_formula *invariant_core (aalta_formula*);
     //aalta_formula* unsat_core (aalta_formula*);    
@@ -111,40 +167,31 @@ class nondeter_prog_state
     
     
     void set_avoid ();
-    aalta_formula* avoid_next_false (aalta_formula::af_prt_set);
+    aalta_formula* avoid_next_false (const aalta_formula::af_prt_set&);
     //aalta_formula::af_prt_set get_next_literal (aalta_formula*);
     
-    aalta_formula* generate_constraint (aalta_formula::af_prt_set);
+    aalta_formula* generate_constraint (const aalta_formula::af_prt_set&);
     
    // aalta_formula* get_new_potential (aalta_formula*, aalta_formula*);
     
     void update_unsatisfied ();
     
-    typedef std::vector<aalta_formula::af_prt_set > history_vec;
-    typedef hash_map<aalta_formula*, history_vec > history_map;
-    static history_map _hist_map;
-    std::pair<aalta_formula::af_prt_set, bool> match_from_history (aalta_formula*, aalta_formula::af_prt_set);
-    void update_history (aalta_formula*, aalta_formula::af_prt_set);
+    std::pair<aalta_formula::af_prt_set, bool> match_from_history (aalta_formula*, const aalta_formula::af_prt_set&);
+    void update_history (aalta_formula*, const aalta_formula::af_prt_set&);
     aalta_formula* MUC (aalta_formula*, aalta_formula*);
     aalta_formula::af_prt_set  UC (aalta_formula*, aalta_formula*);
     void UNSAT_INVARIANT (aalta_formula*);
     void UNSAT_INVARIANT_BACK ();
-    aalta_formula* OR (aalta_formula::af_prt_set);
-    aalta_formula* AND (aalta_formula::af_prt_set);
+    aalta_formula* OR (const aalta_formula::af_prt_set&);
+    aalta_formula* AND (const aalta_formula::af_prt_set&);
     bool is_potential_unsat_invariant ();
     
-    void update_node (aalta_formula*, aalta_formula*, aalta_formula::af_prt_set, aalta_formula*);
-    void add_transition_to_node (aalta_formula*, aalta_formula::af_prt_set, aalta_formula*);
+    void update_node (aalta_formula*, aalta_formula*, const aalta_formula::af_prt_set&, aalta_formula*);
+    void add_transition_to_node (aalta_formula*, const aalta_formula::af_prt_set&, aalta_formula*);
     void fill_witness_from_to (aalta_formula*);
     void clear_f_node_map ();
     
-    static bool _fill_witness_already_done;
-    static aalta_formula::af_prt_set _unsatisfied_untils;
     static void set_unsatisfied_untils ();
-    static aalta_formula::af_prt_set _potential_unsat;
-    static aalta_formula* _unsat_root;
-    static std::vector<std::pair<aalta_formula::af_prt_set, aalta_formula*> > _witness; 
-    static hash_map<aalta_formula*, node*, aalta_formula::af_prt_hash> _f_node_map;
     
     
     
@@ -152,35 +199,30 @@ class nondeter_prog_state
     
     bool is_invariant (aalta_formula*);
     aalta_formula::af_prt_set distinguish_states (aalta_formula::af_prt_set&);
-    aalta_formula::af_prt_set intersect (aalta_formula::af_prt_set, aalta_formula::af_prt_set);
-    static aalta_formula* _global_flatted_formula;
+    aalta_formula::af_prt_set intersect (const aalta_formula::af_prt_set&, const aalta_formula::af_prt_set&);
     aalta_formula* create_check_formula (aalta_formula*, aalta_formula*);
-    aalta_formula* create_check_formula (aalta_formula::af_prt_set, aalta_formula*);
-    aalta_formula* update_avoid (std::vector<aalta_formula::af_prt_set >, int);
-    void update_seq (std::vector<aalta_formula::af_prt_set >&, aalta_formula::af_prt_set, int);
+    aalta_formula* create_check_formula (const aalta_formula::af_prt_set&, aalta_formula*);
+    aalta_formula* update_avoid (const std::vector<aalta_formula::af_prt_set >&, int);
+    void update_seq (std::vector<aalta_formula::af_prt_set >&, const aalta_formula::af_prt_set&, int);
     aalta_formula* previous_state (const aalta_formula::af_prt_set&, const aalta_formula::af_prt_set&);
-    void initial_seq (std::vector<aalta_formula::af_prt_set >&, aalta_formula::af_prt_set);
-    aalta_formula::af_prt_set compute_muc (aalta_formula::af_prt_set, std::vector<aalta_formula::af_prt_set >, int);
-    bool contain_one_of (aalta_formula*, aalta_formula::af_prt_set);
+    void initial_seq (std::vector<aalta_formula::af_prt_set >&, const aalta_formula::af_prt_set&);
+    aalta_formula::af_prt_set compute_muc (const aalta_formula::af_prt_set&, const std::vector<aalta_formula::af_prt_set >&, int);
+    bool contain_one_of (aalta_formula*, const aalta_formula::af_prt_set&);
     bool contain (aalta_formula*, aalta_formula*);
-    aalta_formula* MUC (aalta_formula::af_prt_set, aalta_formula*);
-    void split_binary (aalta_formula::af_prt_set, aalta_formula::af_prt_set&, aalta_formula::af_prt_set&);
+    aalta_formula* MUC (const aalta_formula::af_prt_set&, aalta_formula*);
+    bool unsat_core (const aalta_formula::af_prt_set&, aalta_formula*, aalta_formula::af_prt_set&);
     bool model (const aalta_formula::af_prt_set&, aalta_formula*);
     aalta_formula::af_prt_set propAtoms_child (aalta_formula*);
-    void print_seq (std::vector<aalta_formula::af_prt_set >);
-    aalta_formula* create_list_formula (std::list <aalta_formula::af_prt_set >);
+    void print_seq (const std::vector<aalta_formula::af_prt_set >&);
     void print_f_node_map ();
-    static aalta_formula* _last_invariant;
     aalta_formula* next_in (const aalta_formula::af_prt_set&, aalta_formula*);
     aalta_formula::af_prt_set MUC_set (aalta_formula*, aalta_formula::af_prt_set, aalta_formula*);
     aalta_formula* erase_from (aalta_formula*, aalta_formula*);
     bool is_initially (aalta_formula*);
-    void update_global_flatted_formula (std::vector<aalta_formula::af_prt_set >);
+    void update_global_flatted_formula (const std::vector<aalta_formula::af_prt_set >&);
     void set_input_flatted ();
-    static aalta_formula* _input_flatted;
-    static bool _no_until_fulfilled;
   public:
-    static bool no_until_fulfilled () {return _no_until_fulfilled;}
+    static bool no_until_fulfilled () {return session ()._no_until_fulfilled;}
   private:
     aalta_formula* global_next_n_true ();
     aalta_formula* get_next_n_formula (aalta_formula*, std::set<int>&, std::set<int>&);
@@ -196,11 +238,8 @@ class nondeter_prog_state
     std::pair<aalta_formula::af_prt_set, aalta_formula*> compute_next_pair_via_seq (std::vector<aalta_formula::af_prt_set >, aalta_formula::af_prt_set);
     void update_until_avoid_seqs (aalta_formula::af_prt_set&, std::vector<aalta_formula::af_prt_set >);
     void update_pre_seq_hist (aalta_formula::af_prt_set&, std::vector<aalta_formula::af_prt_set >);
-    static hash_map<aalta_formula*, std::vector<aalta_formula::af_prt_set> > _until_avoid_seqs;
-    static std::vector<aalta_formula::af_prt_set> _pre_seq_hist;
     std::vector<aalta_formula::af_prt_set > adjust_to_unsatisfied (std::vector<aalta_formula::af_prt_set >);
     bool imply_avoid ();
-    static aalta_formula* _current_avoid;
     /*
     size_t _pos;   //position of current state in the list visited
     static std::vector<Constraint> _constraint_stack;
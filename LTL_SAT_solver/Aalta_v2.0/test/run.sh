@@ -0,0 +1,8 @@
+#!/bin/bash
+
+# Answers the formulas of batch.in with aalta --batch and compares the
+# answers with batch.out, one line per formula.
+
+cd "$(dirname "$0")/.." || exit 1
+[ -x ./aalta ] || make release || exit 1
+./aalta --batch < test/batch.in | cut -d' ' -f1 | diff - test/batch.out && echo "all answers as expected"
@@ -0,0 +1,106 @@
+/*
+ * File:   arena.h
+ *
+ * Bump allocator for objects that live until a bulk release, such as
+ * the unique aalta_formula nodes. Objects are copy-constructed into
+ * chunks of growing size; clear () destroys all of them at once and
+ * keeps the largest chunk for the next run. release () destroys a
+ * single object, whose slot is taken by the next create (). Not
+ * thread-safe, the owner has to lock it.
+ */
+
+#ifndef ARENA_H
+#define	ARENA_H
+
+#include <stdlib.h>
+#include <new>
+#include <vector>
+#include <algorithm>
+
+template <class T>
+class arena
+{
+public:
+  arena () : _used (0) {}
+  ~arena ()
+  {
+    clear ();
+    if (!_chunks.empty ())
+      free (_chunks.back ().mem);
+  }
+
+  T *create (const T& orig)
+  {
+    if (!_free.empty ())
+    {
+      T *obj = new (_free.back ()) T (orig);
+      _free.pop_back ();
+      return obj;
+    }
+    if (_chunks.empty () || _used == _chunks.back ().size)
+      grow ();
+    T *obj = new (_chunks.back ().mem + _used) T (orig);
+    _used ++;
+    return obj;
+  }
+
+  // obj must come from create () and not be released yet
+  void release (T *obj)
+  {
+    obj->~T ();
+    _free.push_back (obj);
+  }
+
+  void clear ()
+  {
+    if (_chunks.empty ())
+      return;
+    std::sort (_free.begin (), _free.end ());
+    for (size_t i = 0; i + 1 < _chunks.size (); i ++)
+    {
+      destruct (_chunks[i].mem, _chunks[i].size);
+      free (_chunks[i].mem);
+    }
+    destruct (_chunks.back ().mem, _used);
+    _chunks.erase (_chunks.begin (), _chunks.end () - 1);
+    _used = 0;
+    _free.clear ();
+  }
+
+private:
+  enum { MIN_CHUNK = 64, MAX_CHUNK = 8192 };
+  struct chunk
+  {
+    T *mem;
+    size_t size;
+  };
+  std::vector<chunk> _chunks;
+  size_t _used;                 // objects in _chunks.back ()
+  std::vector<T *> _free;       // released slots, sorted by clear ()
+
+  void grow ()
+  {
+    chunk c;
+    c.size = _chunks.empty () ? MIN_CHUNK : _chunks.back ().size * 2;
+    if (c.size > MAX_CHUNK)
+      c.size = MAX_CHUNK;
+    c.mem = (T *) malloc (c.size * sizeof (T));
+    if (c.mem == NULL)
+      throw std::bad_alloc ();
+    _chunks.push_back (c);
+    _used = 0;
+  }
+
+  // the released objects are already destroyed
+  void destruct (T *mem, size_t n)
+  {
+    for (size_t i = 0; i < n; i ++)
+      if (_free.empty () || !std::binary_search (_free.begin (), _free.end (), mem + i))
+        mem[i].~T ();
+  }
+
+  arena (const arena&);
+  arena& operator = (const arena&);
+};
+
+#endif	/* ARENA_H */
@@ -0,0 +1,92 @@
+/*
+ * File:   statistics.cpp
+ */
+
+#include "statistics.h"
+#include "formula/aalta_formula.h"
+#include <sys/resource.h>
+
+std::atomic<long> statistics::sat_calls[statistics::SITES];
+std::atomic<long> statistics::cnf_vars (0);
+std::atomic<long> statistics::cnf_clauses (0);
+std::atomic<long> statistics::states (0);
+std::atomic<long> statistics::backtracks (0);
+std::atomic<long> statistics::muc_iterations (0);
+std::atomic<long> statistics::result_cache_hits (0);
+std::atomic<long> statistics::result_cache_misses (0);
+std::atomic<long> statistics::successor_cache_hits (0);
+std::atomic<long> statistics::successor_cache_misses (0);
+std::atomic<long> statistics::core_hits (0);
+std::atomic<long> statistics::cores_dropped (0);
+std::atomic<long> statistics::sat_memo_hits (0);
+std::atomic<long> statistics::sat_memo_misses (0);
+std::atomic<long> statistics::collections (0);
+std::atomic<long> statistics::formulas_reclaimed (0);
+std::atomic<long> statistics::formulas_live (0);
+long statistics::queries = 0;
+long statistics::formula_nodes = 0;
+double statistics::parse_time = 0;
+double statistics::simplify_time = 0;
+double statistics::check_time = 0;
+thread_local statistics::site_t statistics::_current = statistics::OTHER;
+
+statistics::scope::scope (site_t s)
+{
+  _prev = _current;
+  _current = s;
+}
+
+statistics::scope::~scope ()
+{
+  _current = _prev;
+}
+
+static double
+rate (long hits, long misses)
+{
+  return hits + misses == 0 ? 0 : (double) hits / (hits + misses);
+}
+
+void
+statistics::write (FILE *out)
+{
+  static const char *names[SITES] = {"other", "get_next_pair", "MUC", "UC", "olg_item::SATCall"};
+  long total = 0;
+  for (int i = 0; i < SITES; i ++)
+    total += sat_calls[i];
+  long hits = aalta_formula::_cache_hits, misses = aalta_formula::_cache_misses;
+  struct rusage self, children;
+  getrusage (RUSAGE_SELF, &self);
+  getrusage (RUSAGE_CHILDREN, &children);
+
+  fprintf (out, "{\n");
+  fprintf (out, "  \"queries\": %ld,\n", queries);
+  fprintf (out, "  \"time\": {\"parse\": %.6f, \"simplify\": %.6f, \"check\": %.6f},\n",
+           parse_time, simplify_time, check_time);
+  fprintf (out, "  \"formula_nodes\": %ld,\n", formula_nodes);
+  fprintf (out, "  \"formula_gc\": {\"collections\": %ld, \"reclaimed\": %ld, \"live\": %ld},\n",
+           collections.load (), formulas_reclaimed.load (), formulas_live.load ());
+  fprintf (out, "  \"states\": %ld,\n", states.load ());
+  fprintf (out, "  \"backtracks\": %ld,\n", backtracks.load ());
+  fprintf (out, "  \"sat_calls\": {\"total\": %ld", total);
+  for (int i = 0; i < SITES; i ++)
+    fprintf (out, ", \"%s\": %ld", names[i], sat_calls[i].load ());
+  fprintf (out, "},\n");
+  fprintf (out, "  \"cores\": {\"hits\": %ld, \"dropped\": %ld},\n", core_hits.load (), cores_dropped.load ());
+  fprintf (out, "  \"sat_memo\": {\"hits\": %ld, \"misses\": %ld, \"hit_rate\": %.4f},\n",
+           sat_memo_hits.load (), sat_memo_misses.load (), rate (sat_memo_hits, sat_memo_misses));
+  fprintf (out, "  \"cnf\": {\"vars\": %ld, \"clauses\": %ld},\n", cnf_vars.load (), cnf_clauses.load ());
+  fprintf (out, "  \"muc_iterations\": %ld,\n", muc_iterations.load ());
+  fprintf (out, "  \"formula_cache\": {\"hits\": %ld, \"misses\": %ld, \"hit_rate\": %.4f},\n",
+           hits, misses, rate (hits, misses));
+  fprintf (out, "  \"result_cache\": {\"hits\": %ld, \"misses\": %ld, \"hit_rate\": %.4f},\n",
+           result_cache_hits.load (), result_cache_misses.load (),
+           rate (result_cache_hits, result_cache_misses));
+  fprintf (out, "  \"successor_cache\": {\"hits\": %ld, \"misses\": %ld, \"hit_rate\": %.4f},\n",
+           successor_cache_hits.load (), successor_cache_misses.load (),
+           rate (successor_cache_hits, successor_cache_misses));
+  //ru_maxrss is in kilobytes on Linux
+  fprintf (out, "  \"peak_rss\": {\"self\": %ld, \"children\": %ld}\n",
+           (long) self.ru_maxrss * 1024, (long) children.ru_maxrss * 1024);
+  fprintf (out, "}\n");
+}
@@ -0,0 +1,69 @@
+/*
+ * Counters and phase times of an aalta run
+ *
+ * File:   statistics.h
+ *
+ * The counters are always collected (they are atomics, like the derived
+ * formula cache counters of aalta_formula); --stats=<file> writes them
+ * as one JSON object when the run ends. A SAT call is charged to the
+ * innermost statistics::scope of the calling thread, so the callers
+ * that matter open a scope naming their site. Parts of the input that
+ * are checked in forked processes (--portfolio, decomposition) are not
+ * counted, only the time spent waiting for them.
+ */
+
+#ifndef STATISTICS_H
+#define STATISTICS_H
+
+#include <atomic>
+#include <stdio.h>
+
+class statistics
+{
+  public:
+    enum site_t { OTHER, NEXT_PAIR, MUC, UC, OLG, SITES };
+
+    static std::atomic<long> sat_calls[SITES];
+    static std::atomic<long> cnf_vars;         // variables and clauses given to Minisat
+    static std::atomic<long> cnf_clauses;
+    static std::atomic<long> states;           // states expanded by nondeter_checker::dfs
+    static std::atomic<long> backtracks;       // failed edges undone by nondeter_checker::dfs
+    static std::atomic<long> muc_iterations;   // SAT calls that shrink an unsat core
+    static std::atomic<long> result_cache_hits;
+    static std::atomic<long> result_cache_misses;
+    static std::atomic<long> successor_cache_hits;    // nondeter_prog_state::get_next_pair
+    static std::atomic<long> successor_cache_misses;
+    static std::atomic<long> core_hits;        // states found to contain a learned core
+    static std::atomic<long> cores_dropped;    // learned cores made redundant by smaller ones
+    static std::atomic<long> sat_memo_hits;    // sat_context::solve answered from its table
+    static std::atomic<long> sat_memo_misses;  // ... by the solver
+    static std::atomic<long> collections;          // of the formulas, by nondeter_checker::dfs
+    static std::atomic<long> formulas_reclaimed;   // released by the collections
+    static std::atomic<long> formulas_live;        // the most formulas a collection kept
+
+    // phases of the queries, accumulated by the main thread
+    static long queries;
+    static long formula_nodes;       // unique formulas created by the queries
+    static double parse_time;
+    static double simplify_time;
+    static double check_time;
+
+    // charges the SAT calls of the calling thread to a site while it exists
+    class scope
+    {
+      public:
+        scope (site_t);
+        ~scope ();
+      private:
+        site_t _prev;
+    };
+    static site_t current () { return _current; }
+
+    static void sat_call () { sat_calls[_current] ++; }
+    static void write (FILE *);
+
+  private:
+    static thread_local site_t _current;
+};
+
+#endif
@@ -2,6 +2,7 @@
 #include "utility.h"
 
 #include <stdio.h>
+#include <unistd.h>
 #include <iostream>
 
 void
@@ -42,3 +43,36 @@ split_str(std::string str)
   
   return result; 
 }
+
+/**
+ * the trace variable of an atom, see utility.h
+ */
+int
+trace_of (const std::string& atom, const std::vector<std::string>& traces)
+{
+  int res = -1;
+  for (int i = 0; i < traces.size (); i++)
+  {
+    size_t n = traces[i].size () + 1;
+    if (atom.size () > n && atom[atom.size () - n] == '_'
+        && atom.compare (atom.size () - n + 1, n - 1, traces[i]) == 0
+        && (res < 0 || traces[i].size () > traces[res].size ()))
+      res = i;
+  }
+  return res;
+}
+
+/**
+ * resident memory of the process, read from /proc/self/statm
+ */
+size_t
+resident_memory ()
+{
+  FILE *fp = fopen ("/proc/self/statm", "r");
+  if (fp == NULL) return 0;
+  unsigned long size, resident;
+  int n = fscanf (fp, "%lu %lu", &size, &resident);
+  fclose (fp);
+  if (n != 2) return 0;
+  return (size_t) resident * sysconf (_SC_PAGESIZE);
+}
@@ -39,6 +39,18 @@ convert_to_string (T val)
  */
 std::vector<std::string> split_str(std::string str);
 
+/**
+ * the trace variable of the atom prop_trace: the index of the longest of
+ * traces that the name ends in after a '_', -1 if there is none; the
+ * proposition and the trace variables may contain '_' themselves
+ */
+int trace_of (const std::string& atom, const std::vector<std::string>& traces);
+
+/**
+ * resident memory of the process in bytes, 0 if it is not available
+ */
+size_t resident_memory ();
+
 
 #endif	/* UTILITY_H */
 
@@ -256,28 +256,55 @@ let intermediate = ref ""
 let enable_nnf = ref false
 let solver_dir = ref ""
 
-(* helper function to invoke an LTL-SAT solver *)
-let invoke_tool name cmd formula analyse_output =
+(* helper function to check `formula` with an LTL-SAT solver, where `run`
+   hands the formula to the solver and returns its output *)
+let check_with_tool name run formula analyse_output =
   if !verbose then printf "%s check...\n%!" name;
   if !write_intermediate then
     begin let oc = open_out !intermediate in
       output_string oc formula; close_out oc
     end;
-  let (ic, oc) = Unix.open_process (!solver_dir ^ "/" ^ cmd) in
-  output_string oc formula;
-  close_out oc;
-  let buf = Buffer.create 16 in
-  (try while true do Buffer.add_channel buf ic 1 done with End_of_file -> ());
-  let status = Unix.close_process (ic, oc) in
-  begin match status with
-    Unix.WEXITED 0 -> ()
-  | _ -> eprintf "failure calling LTL-SAT solver %s\n%!" name; exit 1
-  end;
-  let output = Buffer.contents buf in
+  let output = run formula in
   if !verbose then print_string output;
   let sat = analyse_output output in
   if !verbose then printf "...result: %s\n\n%!" (bool2sat_str sat); sat
 
+(* helper function to invoke an LTL-SAT solver *)
+let invoke_tool name cmd formula analyse_output =
+  let run formula =
+    let (ic, oc) = Unix.open_process (!solver_dir ^ "/" ^ cmd) in
+    output_string oc formula;
+    close_out oc;
+    let buf = Buffer.create 16 in
+    (try while true do Buffer.add_channel buf ic 1 done with End_of_file -> ());
+    let status = Unix.close_process (ic, oc) in
+    begin match status with
+      Unix.WEXITED 0 -> ()
+    | _ -> eprintf "failure calling LTL-SAT solver %s\n%!" name; exit 1
+    end;
+    Buffer.contents buf
+  in
+  check_with_tool name run formula analyse_output
+
+(* file of aalta's persistent result cache, none if empty *)
+let aalta_cache = ref ""
+
+(* aalta process running in batch mode, started on first use and kept
+   for all further checks *)
+let aalta_batch = ref None
+
+let aalta_batch_channels () =
+  match !aalta_batch with
+    Some chans -> chans
+  | None ->
+      let cache =
+        if !aalta_cache = "" then ""
+        else " --cache=" ^ Filename.quote !aalta_cache in
+      let chans = Unix.open_process (!solver_dir ^ "/aalta --batch" ^ cache) in
+      aalta_batch := Some chans;
+      at_exit (fun () -> close_out (snd chans); ignore (Unix.close_process chans));
+      chans
+
 let str_contains s1 s2 =
   let re = Str.regexp_string s2 in
   try ignore (Str.search_forward re s1 0); true with Not_found -> false
@@ -287,10 +314,38 @@ let invoke_pltl f =
   invoke_tool "pltl" "pltl tree verbose" (pltl_ltl_str f)
     (fun o -> str_contains o "is sat")
 
+(* hand the input line `formula` to the aalta process *)
+let aalta_check formula =
+  let run formula =
+    let (ic, oc) = aalta_batch_channels () in
+    output_string oc formula;
+    output_char oc '\n';
+    flush oc;
+    try input_line ic ^ "\n" with End_of_file ->
+      eprintf "failure calling LTL-SAT solver Aalta_v2.0\n%!"; exit 1
+  in
+  check_with_tool "Aalta_v2.0" run formula
+    (fun o ->
+      if str_contains o "unknown" then
+        begin eprintf "Aalta_v2.0 gave up on the formula\n%!"; exit 1 end;
+      not (str_contains o "unsat"))
+
 (* invoke aalta on ltl_formula `f` *)
-let invoke_aalta f =
-  invoke_tool "Aalta_v2.0" "aalta" (aalta_ltl_str f)
-    (fun o -> not (str_contains o "unsat"))
+let invoke_aalta f = aalta_check (aalta_dag_str f)
+
+(* return exists-forall-quantified hyperltl_formula `f` in aalta's input
+   format: the quantifier prefix followed by the body, where `x` on trace
+   `y` is the atom x_y as in transform_exists *)
+let aalta_hyper_str f =
+  let (exists_list, forall_list) = get_trace_variable_lists f in
+  let prefix q xs = String.concat "" (List.map (fun x -> q ^ " " ^ x ^ ". ") xs) in
+  prefix "exists" exists_list ^ prefix "forall" forall_list
+  ^ aalta_dag_str (transform_exists (discard_prefix f))
+
+(* invoke aalta on exists-forall-quantified hyperltl_formula `f`; aalta
+   instantiates the universal trace variables itself, so the input stays
+   linear in the size of `f` *)
+let invoke_aalta_hyper f = aalta_check (aalta_hyper_str f)
 
 type q_structure =
   None | ExistsOnly | ForallOnly | ExistsForall | ForallExist | Alternating
@@ -334,12 +389,20 @@ let transform formula =
       exit 1
 
 let invoke_ref = ref invoke_aalta
+(* solver that takes exists-forall-quantified formulas without expansion *)
+let invoke_hyper_ref = ref (Some invoke_aalta_hyper)
 
 let check_sat f =
-  let ltl_formula = transform f in
-  if !verbose then
-    printf "Equisatisfiable LTL formula:\n%s\n\n%!" (ltl_str ltl_formula);
-  !invoke_ref ltl_formula
+  match !invoke_hyper_ref, quantifier_structure f with
+    Some invoke_hyper, ExistsForall ->
+      check_syntax f;
+      let f = if !enable_nnf then nnf f else f in
+      invoke_hyper f
+  | _ ->
+      let ltl_formula = transform f in
+      if !verbose then
+        printf "Equisatisfiable LTL formula:\n%s\n\n%!" (ltl_str ltl_formula);
+      !invoke_ref ltl_formula
 
 let sat_mode () =
   let f = formula_of_input !input in
@@ -597,10 +660,17 @@ let spec_list =
    "-c", Arg.Int (fun c -> c_ref := c; only_one := true),
    "The number of the formula to check in multi mode.";
    "--cv", Arg.Set show_number, "Show number in multi mode. (default: false)";
-   "--pltl", Arg.Unit (fun () -> invoke_ref := invoke_pltl),
+   "--pltl",
+   Arg.Unit (fun () -> invoke_ref := invoke_pltl; invoke_hyper_ref := None),
    "Check with pltl.";
-   "--aalta", Arg.Unit (fun () -> invoke_ref := invoke_aalta),
+   "--aalta",
+   Arg.Unit
+     (fun () ->
+        invoke_ref := invoke_aalta;
+        invoke_hyper_ref := Some invoke_aalta_hyper),
    "Check with aalta.";
+   "--cache", Arg.Set_string aalta_cache,
+   "The file in which aalta keeps its answers across runs.";
    "-v", Arg.Set verbose, "Be verbose.";
    "--verbose", Arg.Set verbose, "Be verbose.";
    "-i", Arg.String (fun i -> input2 := File i; mode_ref := impl_mode),
@@ -635,7 +705,7 @@ let spec_list =
    "Enable negated normal form representation. (default: false)"]
 let arg_failure arg = raise (Arg.Bad ("Bad argument: " ^ arg))
 let usage_msg =
-  "./eahyper.native ((-f formula_file|-fs formula) ([(-i formula_file|-is formula)|(-e formula_file|-es formula)] | [-r|--reflexive] [-s|--symmetric] [-t|--transitive])) | (-m formulae_file [-c n][--cv]) [--aalta|--pltl] [--nnf] [-v|--verbose] [-wi file]"
+  "./eahyper.native ((-f formula_file|-fs formula) ([(-i formula_file|-is formula)|(-e formula_file|-es formula)] | [-r|--reflexive] [-s|--symmetric] [-t|--transitive])) | (-m formulae_file [-c n][--cv]) [--aalta|--pltl] [--cache file] [--nnf] [-v|--verbose] [-wi file]"
 
 let getenv_opt _var =
   try Some (Sys.getenv "EAHYPER_SOLVER_DIR") with Not_found -> None
@@ -59,6 +59,41 @@ let aalta_ltl_str f =
   let buf = Buffer.create 0 in
   aalta_ltl_str_ buf f; let str = Buffer.contents buf in Buffer.reset buf; str
 
+(* aalta's dag input format: numbered definitions referring to earlier
+   ones, the last one being `f`; equal subformulas are defined once, so
+   the string stays linear in the number of distinct subformulas *)
+let aalta_dag_str f =
+  let buf = Buffer.create 0 in
+  let addb = Buffer.add_string buf in
+  let defs = Hashtbl.create 64 in
+  let next = ref 0 in
+  let rec def f =
+    try Hashtbl.find defs f with Not_found ->
+      let un op f = let i = def f in addb (op ^ " " ^ string_of_int i) in
+      let bin op f g =
+        let i = def f in let j = def g in
+        addb (op ^ " " ^ string_of_int i ^ " " ^ string_of_int j) in
+      let emit () =
+        match f with
+          LTLTrue -> addb "t"
+        | LTLFalse -> addb "f"
+        | LTLVar s -> addb ("a " ^ s)
+        | LTLNot f -> un "!" f
+        | LTLOr (f, g) -> bin "|" f g
+        | LTLAnd (f, g) -> bin "&" f g
+        | LTLImpl (f, g) -> bin "->" f g
+        | LTLEquiv (f, g) -> bin "<->" f g
+        | LTLNext f -> un "X" f
+        | LTLUntil (f, g) -> bin "U" f g
+        | LTLWeakUntil (f, g) -> bin "W" f g
+        | LTLRelease (f, g) -> bin "R" f g
+        | LTLFinally f -> un "F" f
+        | LTLGlobally f -> un "G" f in
+      emit (); addb "; ";
+      let i = !next in incr next; Hashtbl.add defs f i; i in
+  addb "dag "; ignore (def f);
+  let str = Buffer.contents buf in Buffer.reset buf; str
+
 let rec pltl_ltl_str_ buf f =
   let addb = Buffer.add_string buf in
   let rec_ = pltl_ltl_str_ buf in